@@ -1,110 +1,58 @@
-#include <algorithm>
-#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
 
-#include <nlohmann/json.hpp>
-using json = nlohmann::json;
-
-#include <sqlite3.h>
-
-#include "kts_schema.hpp"
+#include "kts_chrome_tracing.hpp"
 
 static void help(std::ostream &os) {
-  os << "Generate a chrome about://tracing json file from a saved trace";
+  os << "usage: chrome-tracing [-o output.json] [-j threads] trace.sqlite...\n"
+     << "Generate a chrome about://tracing json file from saved traces\n";
 }
 
-// https://docs.google.com/document/d/1CvAClvFfyA5R-PhYUmn5OOQtYMH4h6I0nSsKchNAySU/preview#heading=h.yr4qxyxotyw
-
-static const char *PHASE_INSTANT = "i";
-static const char *PHASE_BEGIN = "B";
-static const char *PHASE_END = "E";
-
-struct DurationEvent {
-  int pid;
-  std::string name;
-  std::string cat;
-  std::string ph;
-  double ts;
-
-  DurationEvent(const int pid_, const std::string &name_,
-                const std::string &cat_, const char *ph_, double ts_)
-      : pid(pid_), name(name_), cat(cat_), ph(ph_), ts(ts_) {}
-};
+// buffer the output file in large chunks
+static constexpr size_t OUTPUT_BUFFER_BYTES = 1 << 22;
 
-static void read_trace(json &eventArray, const std::string &path) {
-  std::cerr << __FILE__ << ":" << __LINE__ << " open " << path << "\n";
-
-  sqlite3 *db = nullptr;
+int main(int argc, char **argv) {
 
-  int rc = sqlite3_open(path.c_str(), &db);
-  if (rc) {
-    std::cerr << "Can't open database: " << sqlite3_errmsg(db) << std::endl;
-    exit(1);
+  std::string outPath = "trace.json";
+  size_t numThreads = std::thread::hardware_concurrency();
+  std::vector<std::string> inputs;
+  for (int i = 1; i < argc; ++i) {
+    if (0 == std::strcmp(argv[i], "-o") && i + 1 < argc) {
+      outPath = argv[++i];
+    } else if (0 == std::strcmp(argv[i], "-j") && i + 1 < argc) {
+      numThreads = std::strtoul(argv[++i], nullptr, 10);
+    } else if (0 == std::strcmp(argv[i], "-h") ||
+               0 == std::strcmp(argv[i], "--help")) {
+      help(std::cout);
+      return 0;
+    } else {
+      inputs.push_back(argv[i]);
+    }
   }
-
-  auto event_callback = [&](const schema::Event &event) -> int {
-    // time comes in as real seconds. output expects microseconds
-    const double timeUs = event.time * 1000000;
-
-    eventArray.emplace_back(json{{"name", event.name},
-                                 {"cat", event.kind},
-                                 {"ph", PHASE_INSTANT},
-                                 {"ts", std::to_string(timeUs).c_str()},
-                                 {"pid", event.rank},
-                                 {"args", json({})}});
-    return 0;
-  };
-
-  std::vector<DurationEvent> durEvents;
-  // converts database entries into DurationEvents, which later need to be
-  // sorted by timestamp before they are dumped to json
-  auto span_callback = [&](const schema::Span &span) -> int {
-    // time comes in as real seconds. output expects microseconds
-    const double startUs = span.start * 1000000;
-    const double stopUs = span.stop * 1000000;
-
-    durEvents.emplace_back(span.rank, span.name, span.kind, PHASE_BEGIN,
-                           startUs);
-    durEvents.emplace_back(span.rank, span.name, span.kind, PHASE_END, stopUs);
-    return 0;
-  };
-
-  std::cerr << __FILE__ << ":" << __LINE__ << " convert events\n";
-  schema::for_all_events(db, event_callback);
-  std::cerr << __FILE__ << ":" << __LINE__ << " read spans\n";
-  schema::for_all_spans(db, span_callback);
-  std::cerr << __FILE__ << ":" << __LINE__ << " sort spans\n";
-  std::sort(durEvents.begin(), durEvents.end(),
-            [](const DurationEvent &a, const DurationEvent &b) {
-              return a.ts < b.ts;
-            });
-  std::cerr << __FILE__ << ":" << __LINE__ << " convert spans\n";
-  for (const DurationEvent &de : durEvents) {
-    eventArray.emplace_back(json{{"name", de.name},
-                                 {"cat", de.cat},
-                                 {"ph", de.ph},
-                                 {"ts", std::to_string(de.ts).c_str()},
-                                 {"pid", de.pid}});
+  if (inputs.empty()) {
+    help(std::cerr);
+    return 1;
   }
 
-  sqlite3_close(db);
-  db = nullptr;
-}
-
-int main(int argc, char **argv) {
+  FILE *f = std::fopen(outPath.c_str(), "wb");
+  if (!f) {
+    std::cerr << "Can't open " << outPath << " for writing\n";
+    return 1;
+  }
+  std::vector<char> buf(OUTPUT_BUFFER_BYTES);
+  std::setvbuf(f, buf.data(), _IOFBF, buf.size());
 
-  json traceEvents = json::array();
+  std::cerr << "convert " << inputs.size() << " database(s)\n";
+  schema::write_chrome_trace(f, inputs, numThreads);
 
-  for (int i = 1; i < argc; ++i) {
-    read_trace(traceEvents, argv[i]);
+  if (0 != std::fclose(f)) {
+    std::cerr << "error writing " << outPath << "\n";
+    return 1;
   }
-
-  std::cerr << __FILE__ << ":" << __LINE__ << " dump JSON...\n";
-  json j;
-  j["traceEvents"] = traceEvents;
-  j["displayTimeUnit"] = "ms";
-  j["otherData"] = json{{"version", "kts chrome-tracing"}};
-  j["stackFrames"] = json({});
-  j["samples"] = json::array();
-  std::ofstream("test.json", std::ios::binary) << std::setw(4) << j << "\n";
-}
\ No newline at end of file
+  std::cerr << "wrote " << outPath << "\n";
+}
@@ -0,0 +1,141 @@
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <sqlite3.h>
+
+#include "kts_schema.hpp"
+#include "kts_trace_log.hpp"
+
+static void help(std::ostream &os) {
+  os << "usage: kts-convert [-o trace.sqlite] trace.ktslog...\n"
+     << "Add the records of KTS_OUTPUT=log binary logs to their trace "
+        "databases\n"
+     << "  -o PATH   the database to write, for a single log (the log's path "
+        "with .sqlite for .ktslog)\n";
+}
+
+static void exec(sqlite3 *db, const char *sql) {
+  char *errMsg = nullptr;
+  if (SQLITE_OK != sqlite3_exec(db, sql, 0, 0, &errMsg)) {
+    std::cerr << "SQL error: " << errMsg << "\n  in: " << sql << std::endl;
+    sqlite3_free(errMsg);
+    exit(1);
+  }
+}
+
+static int64_t query_int(sqlite3 *db, const char *sql) {
+  sqlite3_stmt *stmt = schema::prepare_query(db, sql);
+  const int64_t v =
+      SQLITE_ROW == sqlite3_step(stmt) ? sqlite3_column_int64(stmt, 0) : 0;
+  sqlite3_finalize(stmt);
+  return v;
+}
+
+// the database next to a log, which holds the rest of the run's tables
+static std::string database_for(const std::string &log) {
+  const std::string ext = ".ktslog";
+  if (log.size() > ext.size() &&
+      0 == log.compare(log.size() - ext.size(), ext.size(), ext)) {
+    return log.substr(0, log.size() - ext.size()) + ".sqlite";
+  }
+  return log + ".sqlite";
+}
+
+// write the records of the log at logPath into the database at dbPath, in one
+// transaction. Returns the number of records
+static uint64_t convert(const std::string &logPath, const std::string &dbPath) {
+  schema::LogReader log(logPath);
+
+  sqlite3 *db = nullptr;
+  if (SQLITE_OK != sqlite3_open(dbPath.c_str(), &db)) {
+    std::cerr << "Can't open database: " << sqlite3_errmsg(db) << std::endl;
+    exit(1);
+  }
+  schema::create_tables(db);
+  if (query_int(db, "SELECT (SELECT COUNT(*) FROM SpanRecords) + "
+                    "(SELECT COUNT(*) FROM EventRecords);")) {
+    std::cerr << dbPath << " already has records, not converting " << logPath
+              << "\n";
+    exit(1);
+  }
+  schema::init(db);
+  exec(db, "BEGIN;");
+
+  // a database without the run's tables, e.g. from -o
+  if (0 == query_int(db, "SELECT COUNT(*) FROM Meta "
+                         "WHERE Key = 'schema_version';")) {
+    const std::string version = std::to_string(schema::VERSION);
+    schema::insert(db, schema::Meta{"schema_version", version.c_str()});
+    for (int k = 0; k < int(schema::Kind::NUM_KINDS); ++k) {
+      schema::insert(db, schema::KindName{schema::Kind(k)});
+    }
+  }
+
+  const int rank = log.rank();
+  uint64_t records = 0;
+  schema::LogEntry e;
+  while (log.next(e)) {
+    if (e.isName) {
+      schema::insert(db, schema::Name{e.nameID, e.name.c_str()});
+      continue;
+    }
+    const schema::LogRecord &r = e.record;
+    ++records;
+    if (r.type == schema::LogRecord::Type::EVENT) {
+      schema::insert(db, schema::EventRecord{rank, r.tid, r.nameID, r.kind,
+                                             r.device, r.parentID, r.depth,
+                                             r.start});
+      continue;
+    }
+    schema::insert(db, schema::SpanRecord{r.id, rank, r.tid, r.nameID, r.kind,
+                                          r.device, r.parentID, r.depth,
+                                          r.start, r.stop});
+    if (r.type == schema::LogRecord::Type::COPY) {
+      schema::insert(db, schema::DeepCopyRecord{r.id, r.srcSpaceID,
+                                                r.srcNameID, r.dstSpaceID,
+                                                r.dstNameID, r.bytes});
+    }
+  }
+
+  exec(db, "COMMIT;");
+  schema::finalize(db);
+  sqlite3_close(db);
+  return records;
+}
+
+int main(int argc, char **argv) {
+
+  std::string outPath;
+  std::vector<std::string> inputs;
+  for (int i = 1; i < argc; ++i) {
+    if (0 == std::strcmp(argv[i], "-o") && i + 1 < argc) {
+      outPath = argv[++i];
+    } else if (0 == std::strcmp(argv[i], "-h") ||
+               0 == std::strcmp(argv[i], "--help")) {
+      help(std::cout);
+      return 0;
+    } else {
+      inputs.push_back(argv[i]);
+    }
+  }
+  if (inputs.empty()) {
+    help(std::cerr);
+    return 1;
+  }
+  if (!outPath.empty() && inputs.size() > 1) {
+    std::cerr << "-o takes a single log\n";
+    return 1;
+  }
+
+  // the schema's prepared statements are shared, so one log at a time
+  for (const std::string &input : inputs) {
+    const std::string dbPath = outPath.empty() ? database_for(input) : outPath;
+    const uint64_t records = convert(input, dbPath);
+    std::cerr << "wrote " << records << " records from " << input << " to "
+              << dbPath << "\n";
+  }
+}
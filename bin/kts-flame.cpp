@@ -0,0 +1,271 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <sqlite3.h>
+
+#include "kts_schema.hpp"
+
+static void help(std::ostream &os) {
+  os << "usage: kts-flame [-o output] [--table] [--per-rank] trace.sqlite...\n"
+     << "Write folded stacks (region;...;kernel self-microseconds) for flame\n"
+     << "graph tools, or with --table the inclusive and exclusive time of\n"
+     << "each region path\n";
+}
+
+// Stacks are interned as paths: a path is a name directly inside a parent
+// path. Path 0 is the root and has no name.
+struct Path {
+  uint32_t parent;
+  uint32_t name;
+  uint64_t count = 0;
+  int64_t inclusive = 0; // ns
+  int64_t exclusive = 0;
+};
+
+class Paths {
+public:
+  Paths() : paths_{Path{0, 0}} {}
+
+  uint32_t intern(uint32_t parent, uint32_t name) {
+    const uint64_t key = (uint64_t(parent) << 32) | name;
+    auto it = ids_.find(key);
+    if (it != ids_.end()) {
+      return it->second;
+    }
+    const uint32_t id = paths_.size();
+    paths_.push_back(Path{parent, name});
+    ids_.emplace(key, id);
+    return id;
+  }
+
+  Path &operator[](uint32_t id) { return paths_[id]; }
+  size_t size() const { return paths_.size(); }
+
+private:
+  std::vector<Path> paths_;
+  std::unordered_map<uint64_t, uint32_t> ids_;
+};
+
+// names from every input, merged by text
+class Names {
+public:
+  uint32_t intern(const std::string &name) {
+    auto it = ids_.find(name);
+    if (it != ids_.end()) {
+      return it->second;
+    }
+    const uint32_t id = names_.size();
+    names_.push_back(name);
+    ids_.emplace(name, id);
+    return id;
+  }
+
+  const std::string &operator[](uint32_t id) const { return names_[id]; }
+
+private:
+  std::vector<std::string> names_;
+  std::unordered_map<std::string, uint32_t> ids_;
+};
+
+static Names names;
+static Paths paths;
+
+// an open span during the sweep
+struct Frame {
+  int64_t start;
+  int64_t stop;
+  int64_t children; // time covered by spans directly inside this one
+  uint32_t path;
+};
+
+// close the innermost frame, crediting its time to its path and to its
+// parent frame
+static void pop(std::vector<Frame> &stack) {
+  const Frame f = stack.back();
+  stack.pop_back();
+  const int64_t dur = f.stop - f.start;
+  Path &p = paths[f.path];
+  p.count += 1;
+  p.inclusive += dur;
+  p.exclusive += std::max(dur - f.children, int64_t(0));
+  if (!stack.empty()) {
+    // a span that outlives its parent only counts while the parent is open
+    stack.back().children += std::min(f.stop, stack.back().stop) - f.start;
+  }
+}
+
+// Sweep the spans of one database in (Rank, Tid, Start, Stop DESC) order. A
+// span is inside the innermost open span on the same thread that has not
+// stopped by the time it starts, so one stack per thread is enough. SQLite
+// sorts out of core, so memory is bounded by the stack depth and the number
+// of distinct paths.
+static void read_trace(const std::string &path, bool perRank) {
+  std::cerr << "read " << path << "\n";
+  sqlite3 *db = nullptr;
+  if (SQLITE_OK !=
+      sqlite3_open_v2(path.c_str(), &db, SQLITE_OPEN_READONLY, nullptr)) {
+    std::cerr << "Can't open database: " << sqlite3_errmsg(db) << std::endl;
+    exit(1);
+  }
+
+  // this database's NameIDs to ours. Folded stacks separate frames with ';'
+  std::vector<uint32_t> nameMap;
+  sqlite3_stmt *stmt =
+      schema::prepare_query(db, "SELECT ID, Name FROM Names;");
+  while (SQLITE_ROW == sqlite3_step(stmt)) {
+    const int64_t id = sqlite3_column_int64(stmt, 0);
+    std::string name =
+        reinterpret_cast<const char *>(sqlite3_column_text(stmt, 1));
+    std::replace(name.begin(), name.end(), ';', ':');
+    if (id < 0) {
+      continue;
+    }
+    if (size_t(id) >= nameMap.size()) {
+      nameMap.resize(id + 1, names.intern("<unknown>"));
+    }
+    nameMap[id] = names.intern(name);
+  }
+  sqlite3_finalize(stmt);
+
+  stmt = schema::prepare_query(db,
+                               "SELECT Rank, Tid, NameID, Start, Stop "
+                               "FROM SpanRecords "
+                               "ORDER BY Rank, Tid, Start, Stop DESC;");
+  std::vector<Frame> stack;
+  int64_t rank = -1, tid = -1;
+  uint32_t root = 0;
+  while (SQLITE_ROW == sqlite3_step(stmt)) {
+    const int64_t r = sqlite3_column_int64(stmt, 0);
+    const int64_t t = sqlite3_column_int64(stmt, 1);
+    const int64_t nameID = sqlite3_column_int64(stmt, 2);
+    const int64_t start = sqlite3_column_int64(stmt, 3);
+    const int64_t stop = sqlite3_column_int64(stmt, 4);
+
+    if (r != rank || t != tid) {
+      while (!stack.empty()) {
+        pop(stack);
+      }
+      if (r != rank && perRank) {
+        root = paths.intern(0, names.intern("rank " + std::to_string(r)));
+      }
+      rank = r;
+      tid = t;
+    }
+    while (!stack.empty() && stack.back().stop <= start) {
+      pop(stack);
+    }
+
+    const uint32_t name = (nameID >= 0 && size_t(nameID) < nameMap.size())
+                              ? nameMap[nameID]
+                              : names.intern("<unknown>");
+    const uint32_t parent = stack.empty() ? root : stack.back().path;
+    stack.push_back(Frame{start, stop, 0, paths.intern(parent, name)});
+  }
+  while (!stack.empty()) {
+    pop(stack);
+  }
+  sqlite3_finalize(stmt);
+  sqlite3_close(db);
+}
+
+static std::string path_string(uint32_t id, char sep) {
+  std::vector<uint32_t> frames;
+  for (; id != 0; id = paths[id].parent) {
+    frames.push_back(paths[id].name);
+  }
+  std::string s;
+  for (auto it = frames.rbegin(); it != frames.rend(); ++it) {
+    if (!s.empty()) {
+      s += sep;
+    }
+    s += names[*it];
+  }
+  return s;
+}
+
+// one "frame;frame;frame microseconds" line per path with self time
+static void write_folded(FILE *f) {
+  for (uint32_t id = 1; id < paths.size(); ++id) {
+    const int64_t us = (paths[id].exclusive + 500) / 1000;
+    if (us > 0) {
+      std::fprintf(f, "%s %lld\n", path_string(id, ';').c_str(),
+                   static_cast<long long>(us));
+    }
+  }
+}
+
+// region paths by inclusive time. With --per-rank, the "rank N" roots are
+// never spans themselves and are left out
+static void write_table(FILE *f) {
+  std::vector<uint32_t> ids;
+  for (uint32_t id = 1; id < paths.size(); ++id) {
+    if (paths[id].count) {
+      ids.push_back(id);
+    }
+  }
+  std::sort(ids.begin(), ids.end(), [](uint32_t a, uint32_t b) {
+    return paths[a].inclusive > paths[b].inclusive;
+  });
+  std::fprintf(f, "%14s %14s %10s  %s\n", "Inclusive(s)", "Exclusive(s)",
+               "Count", "Path");
+  for (const uint32_t id : ids) {
+    const Path &p = paths[id];
+    std::fprintf(f, "%14.6f %14.6f %10llu  %s\n", p.inclusive * 1e-9,
+                 p.exclusive * 1e-9, static_cast<unsigned long long>(p.count),
+                 path_string(id, '/').c_str());
+  }
+}
+
+int main(int argc, char **argv) {
+
+  std::string outPath;
+  bool table = false;
+  bool perRank = false;
+  std::vector<std::string> inputs;
+  for (int i = 1; i < argc; ++i) {
+    if (0 == std::strcmp(argv[i], "-o") && i + 1 < argc) {
+      outPath = argv[++i];
+    } else if (0 == std::strcmp(argv[i], "--table")) {
+      table = true;
+    } else if (0 == std::strcmp(argv[i], "--per-rank")) {
+      perRank = true;
+    } else if (0 == std::strcmp(argv[i], "-h") ||
+               0 == std::strcmp(argv[i], "--help")) {
+      help(std::cout);
+      return 0;
+    } else {
+      inputs.push_back(argv[i]);
+    }
+  }
+  if (inputs.empty()) {
+    help(std::cerr);
+    return 1;
+  }
+
+  for (const std::string &input : inputs) {
+    read_trace(input, perRank);
+  }
+
+  FILE *f = stdout;
+  if (!outPath.empty()) {
+    f = std::fopen(outPath.c_str(), "w");
+    if (!f) {
+      std::cerr << "Can't open " << outPath << " for writing\n";
+      return 1;
+    }
+  }
+  if (table) {
+    write_table(f);
+  } else {
+    write_folded(f);
+  }
+  if (f != stdout && 0 != std::fclose(f)) {
+    std::cerr << "error writing " << outPath << "\n";
+    return 1;
+  }
+}
@@ -0,0 +1,323 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <sqlite3.h>
+
+#include "kts_clock_alignment.hpp"
+#include "kts_report.hpp"
+#include "kts_schema.hpp"
+#include "kts_trace_reader.hpp"
+
+static void help(std::ostream &os) {
+  os << "usage: kts-imbalance [options] trace.sqlite...\n"
+     << "Load imbalance and wait time of kernels, fences and regions across "
+        "ranks\n"
+     << "  --sort wait|imbalance|max|name  order of the rows (wait)\n"
+     << "  --top N        print the first N rows, 0 for all (20)\n"
+     << "  --kind KIND    only this kind, e.g. REGION or PARALLEL_FOR\n"
+     << "  --name REGEX   only names matching REGEX\n"
+     << "  --format table|csv|json  (table)\n"
+     << "  -j N           reader threads (all cores)\n";
+}
+
+// The i-th launch of a name on each rank that made at least i + 1, taken to
+// be the same step of an SPMD program. Times are on the shared timeline.
+struct Instance {
+  int64_t ranks = 0;
+  int64_t firstStart = std::numeric_limits<int64_t>::max();
+  int64_t lastStart = std::numeric_limits<int64_t>::min();
+  int64_t lastStop = std::numeric_limits<int64_t>::min();
+  // the stops, summed as offsets from the first one seen so the sum stays
+  // small however long the run
+  int64_t ref = 0;
+  int64_t stops = 0;
+
+  void add(int64_t start, int64_t stop) {
+    if (0 == ranks) {
+      ref = stop;
+    }
+    ++ranks;
+    firstStart = std::min(firstStart, start);
+    lastStart = std::max(lastStart, start);
+    lastStop = std::max(lastStop, stop);
+    stops += stop - ref;
+  }
+
+  void merge(const Instance &other) {
+    if (0 == other.ranks) {
+      return;
+    }
+    if (0 == ranks) {
+      *this = other;
+      return;
+    }
+    ranks += other.ranks;
+    firstStart = std::min(firstStart, other.firstStart);
+    lastStart = std::max(lastStart, other.lastStart);
+    lastStop = std::max(lastStop, other.lastStop);
+    stops += other.stops + other.ranks * (other.ref - ref);
+  }
+
+  // summed over the ranks, the time from each one's stop to the last one's
+  int64_t wait() const { return ranks * (lastStop - ref) - stops; }
+};
+
+// one rank's launches of a name
+struct RankTotals {
+  int64_t count = 0;
+  int64_t busy = 0; // ns
+};
+
+struct Stats {
+  std::string kind;
+  std::string name;
+  std::vector<Instance> instances;
+  std::map<int, RankTotals> ranks;
+
+  void merge(const Stats &other) {
+    if (instances.size() < other.instances.size()) {
+      instances.resize(other.instances.size());
+    }
+    for (size_t i = 0; i < other.instances.size(); ++i) {
+      instances[i].merge(other.instances[i]);
+    }
+    for (const auto &kv : other.ranks) {
+      RankTotals &r = ranks[kv.first];
+      r.count += kv.second.count;
+      r.busy += kv.second.busy;
+    }
+  }
+};
+
+// stats by kind and name
+struct Analysis {
+  std::unordered_map<std::string, Stats> stats;
+
+  Stats &at(const std::string &kind, const std::string &name) {
+    Stats &s = stats[kind + '\0' + name];
+    if (s.name.empty() && s.kind.empty()) {
+      s.kind = kind;
+      s.name = name;
+    }
+    return s;
+  }
+
+  void merge(const Analysis &other) {
+    for (const auto &kv : other.stats) {
+      at(kv.second.kind, kv.second.name).merge(kv.second);
+    }
+  }
+};
+
+// Add the spans of one database to analysis, in start order so each rank's
+// launches of a name are numbered as they happened
+static void read_trace(Analysis &analysis, const std::string &path,
+                       const schema::ClockAlignment &clocks, int64_t origin) {
+  sqlite3 *db = nullptr;
+  if (SQLITE_OK !=
+      sqlite3_open_v2(path.c_str(), &db, SQLITE_OPEN_READONLY, nullptr)) {
+    std::cerr << "Can't open database: " << sqlite3_errmsg(db) << std::endl;
+    exit(1);
+  }
+  const std::vector<std::string> names =
+      schema::read_dictionary(db, "SELECT ID, Name FROM Names;");
+  const std::vector<std::string> kinds =
+      schema::read_dictionary(db, "SELECT ID, Name FROM Kinds;");
+
+  // stats for each (KindID, NameID) seen in this database, and the totals of
+  // the rank last seen with it
+  struct Local {
+    Stats *stats;
+    int rank;
+    RankTotals *totals;
+  };
+  std::unordered_map<uint64_t, Local> local;
+
+  sqlite3_stmt *stmt = schema::prepare_query(
+      db, "SELECT Rank, KindID, NameID, Start, Stop FROM SpanRecords "
+          "ORDER BY Start;");
+  while (SQLITE_ROW == sqlite3_step(stmt)) {
+    const int rank = sqlite3_column_int(stmt, 0);
+    const int64_t kindID = sqlite3_column_int64(stmt, 1);
+    const int64_t nameID = sqlite3_column_int64(stmt, 2);
+    const uint64_t key = (uint64_t(kindID) << 32) | uint32_t(nameID);
+    auto it = local.find(key);
+    if (it == local.end()) {
+      Stats &s = analysis.at(schema::lookup(kinds, kindID),
+                             schema::lookup(names, nameID));
+      it = local.emplace(key, Local{&s, rank, &s.ranks[rank]}).first;
+    }
+    Local &l = it->second;
+    if (l.rank != rank) {
+      l.rank = rank;
+      l.totals = &l.stats->ranks[rank];
+    }
+
+    const int64_t start =
+        clocks.align(rank, sqlite3_column_int64(stmt, 3)) - origin;
+    const int64_t stop =
+        clocks.align(rank, sqlite3_column_int64(stmt, 4)) - origin;
+    const size_t i = size_t(l.totals->count++);
+    l.totals->busy += stop - start;
+    std::vector<Instance> &instances = l.stats->instances;
+    if (i >= instances.size()) {
+      instances.resize(i + 1);
+    }
+    instances[i].add(start, stop);
+  }
+  sqlite3_finalize(stmt);
+  sqlite3_close(db);
+}
+
+// a row of the report. Times are in seconds
+struct Row {
+  const Stats *stats;
+  int64_t count;
+  double mean;      // busy time per rank
+  double max;       // busy time of the busiest rank
+  int maxRank;
+  double imbalance; // max / mean - 1
+  double wait;      // per rank, waiting at the end of launches for the last
+  double skew;      // mean spread of start times of a launch across ranks
+};
+
+static Row make_row(const Stats &s) {
+  Row r{&s, 0, 0, 0, -1, 0, 0, 0};
+  int64_t busy = 0;
+  int64_t maxBusy = std::numeric_limits<int64_t>::min();
+  for (const auto &kv : s.ranks) {
+    r.count += kv.second.count;
+    busy += kv.second.busy;
+    if (kv.second.busy > maxBusy) {
+      maxBusy = kv.second.busy;
+      r.maxRank = kv.first;
+    }
+  }
+  const double ranks = double(s.ranks.size());
+  r.mean = busy * 1e-9 / ranks;
+  r.max = maxBusy * 1e-9;
+  r.imbalance = r.mean > 0 ? r.max / r.mean - 1 : 0;
+
+  int64_t wait = 0;
+  int64_t skew = 0;
+  int64_t shared = 0;
+  for (const Instance &i : s.instances) {
+    wait += i.wait();
+    if (i.ranks > 1) {
+      skew += i.lastStart - i.firstStart;
+      ++shared;
+    }
+  }
+  r.wait = wait * 1e-9 / ranks;
+  r.skew = shared ? skew * 1e-9 / double(shared) : 0;
+  return r;
+}
+
+static void write_table(const std::vector<Row> &rows) {
+  std::printf("%-16s %6s %10s %12s %12s %8s %10s %12s %12s  %s\n", "Kind",
+              "Ranks", "Count", "Mean(s)", "Max(s)", "MaxRank", "Imbalance",
+              "Wait(s)", "Skew(s)", "Name");
+  for (const Row &r : rows) {
+    std::printf("%-16s %6zu %10lld %12.6f %12.6f %8d %9.2f%% %12.6f %12.6g  "
+                "%s\n",
+                r.stats->kind.c_str(), r.stats->ranks.size(),
+                static_cast<long long>(r.count), r.mean, r.max, r.maxRank,
+                100 * r.imbalance, r.wait, r.skew, r.stats->name.c_str());
+  }
+}
+
+static void write_csv(const std::vector<Row> &rows) {
+  std::printf("Kind,Name,Ranks,Count,Mean,Max,MaxRank,Imbalance,Wait,Skew\n");
+  for (const Row &r : rows) {
+    std::printf("%s,%s,%zu,%lld,%.9g,%.9g,%d,%.6g,%.9g,%.9g\n",
+                r.stats->kind.c_str(),
+                schema::csv_string(r.stats->name).c_str(),
+                r.stats->ranks.size(), static_cast<long long>(r.count), r.mean,
+                r.max, r.maxRank, r.imbalance, r.wait, r.skew);
+  }
+}
+
+static void write_json(const std::vector<Row> &rows,
+                       const std::string &clocks) {
+  std::printf("{\"clocks\":%s,\"rows\":[",
+              schema::json_string(clocks).c_str());
+  for (size_t i = 0; i < rows.size(); ++i) {
+    const Row &r = rows[i];
+    std::printf("%s\n{\"kind\":%s,\"name\":%s,\"ranks\":%zu,\"count\":%lld,"
+                "\"mean\":%.9g,\"max\":%.9g,\"max_rank\":%d,"
+                "\"imbalance\":%.6g,\"wait\":%.9g,\"skew\":%.9g}",
+                i ? "," : "", schema::json_string(r.stats->kind).c_str(),
+                schema::json_string(r.stats->name).c_str(),
+                r.stats->ranks.size(), static_cast<long long>(r.count), r.mean,
+                r.max, r.maxRank, r.imbalance, r.wait, r.skew);
+  }
+  std::printf("\n]}\n");
+}
+
+int main(int argc, char **argv) {
+
+  schema::ReportOptions options;
+  int status = 0;
+  if (!schema::parse_report_options(argc, argv,
+                                    {"wait", "imbalance", "max", "name"}, help,
+                                    options, status)) {
+    return status;
+  }
+  const std::vector<std::string> &inputs = options.inputs;
+
+  const std::vector<schema::ClockAlignment> clocks =
+      schema::read_clock_alignments(inputs);
+  // the inputs' alignments are all empty or all of one source
+  const std::string source =
+      clocks.front().empty() ? "none" : clocks.front().source();
+  if (source == "none") {
+    std::cerr << "no clock offsets in the inputs; wait and skew assume the "
+                 "ranks' clocks started together\n";
+  }
+
+  // each thread analyzes the inputs it takes into its own Analysis
+  const int64_t origin = schema::shared_origin(clocks);
+  const Analysis analysis = schema::read_in_parallel<Analysis>(
+      inputs.size(), options.numThreads, [&](Analysis &a, size_t i) {
+        read_trace(a, inputs[i], clocks[i], origin);
+      });
+
+  std::vector<Row> rows;
+  for (const auto &kv : analysis.stats) {
+    const Stats &s = kv.second;
+    if (s.ranks.empty() || !options.matches(s.kind, s.name)) {
+      continue;
+    }
+    rows.push_back(make_row(s));
+  }
+
+  auto by = [&](const Row &a, const Row &b) {
+    if (options.sort == "imbalance") {
+      return a.imbalance > b.imbalance;
+    } else if (options.sort == "max") {
+      return a.max > b.max;
+    } else if (options.sort == "name") {
+      return a.stats->name < b.stats->name;
+    }
+    return a.wait > b.wait;
+  };
+  std::sort(rows.begin(), rows.end(), by);
+  if (options.top && rows.size() > options.top) {
+    rows.resize(options.top);
+  }
+
+  if (options.format == "csv") {
+    write_csv(rows);
+  } else if (options.format == "json") {
+    write_json(rows, source);
+  } else {
+    write_table(rows);
+  }
+}
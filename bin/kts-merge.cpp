@@ -0,0 +1,258 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sqlite3.h>
+
+#include "kts_schema.hpp"
+
+static void help(std::ostream &os) {
+  os << "usage: kts-merge [-o merged.sqlite] [-j threads] trace.sqlite...\n"
+     << "Combine per-rank trace databases into one database\n";
+}
+
+static void exec(sqlite3 *db, const std::string &sql) {
+  char *errMsg = nullptr;
+  if (SQLITE_OK != sqlite3_exec(db, sql.c_str(), 0, 0, &errMsg)) {
+    std::cerr << "SQL error: " << errMsg << "\n  in: " << sql << std::endl;
+    sqlite3_free(errMsg);
+    exit(1);
+  }
+}
+
+// the first column of the first row of sql, or def if there is none
+static std::string query_text(sqlite3 *db, const std::string &sql,
+                              const std::string &def) {
+  sqlite3_stmt *stmt = nullptr;
+  if (SQLITE_OK != sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, 0)) {
+    std::cerr << "Failed to prepare statement: " << sqlite3_errmsg(db)
+              << std::endl;
+    exit(1);
+  }
+  std::string result = def;
+  if (SQLITE_ROW == sqlite3_step(stmt) &&
+      SQLITE_NULL != sqlite3_column_type(stmt, 0)) {
+    result = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0));
+  }
+  sqlite3_finalize(stmt);
+  return result;
+}
+
+static sqlite3 *open_output(const std::string &path) {
+  std::remove(path.c_str());
+  sqlite3 *db = nullptr;
+  if (SQLITE_OK != sqlite3_open(path.c_str(), &db)) {
+    std::cerr << "Can't open database: " << sqlite3_errmsg(db) << std::endl;
+    exit(1);
+  }
+  // the output is rebuilt from scratch if the merge fails, so skip the journal
+  exec(db, "PRAGMA journal_mode = OFF;"
+           "PRAGMA synchronous = OFF;"
+           "PRAGMA cache_size = -262144;");
+  schema::create_tables(db);
+  // names are merged by their text
+  exec(db, "CREATE UNIQUE INDEX IF NOT EXISTS NamesName ON Names(Name);");
+  return db;
+}
+
+// Append the contents of the database at path to db. Names are merged by
+// text; span, region path and kernel statistic IDs are offset past the ones
+// already in db
+static void merge_one(sqlite3 *db, const std::string &path) {
+  char *attach = sqlite3_mprintf("ATTACH %Q AS src;", path.c_str());
+  exec(db, attach);
+  sqlite3_free(attach);
+
+  const std::string version = query_text(
+      db, "SELECT Value FROM src.Meta WHERE Key = 'schema_version';", "");
+  if (version != std::to_string(schema::VERSION)) {
+    std::cerr << path << ": schema_version '" << version << "', expected "
+              << schema::VERSION << "\n";
+    exit(1);
+  }
+
+  const std::string spanOffset = query_text(
+      db, "SELECT IFNULL(MAX(ID) + 1, 0) FROM main.SpanRecords;", "0");
+  const std::string pathOffset =
+      query_text(db, "SELECT IFNULL(MAX(ID), 0) FROM main.RegionPaths;", "0");
+  const std::string statOffset = query_text(
+      db, "SELECT IFNULL(MAX(ID) + 1, 0) FROM main.KernelStats;", "0");
+  const std::string pathID = "CASE WHEN s.PathID = 0 THEN 0 ELSE s.PathID + " +
+                             pathOffset + " END";
+
+  exec(db, "BEGIN TRANSACTION;");
+  exec(db, "INSERT OR IGNORE INTO main.Meta SELECT Key, Value FROM src.Meta;"
+           "INSERT OR IGNORE INTO main.Kinds SELECT ID, Name FROM src.Kinds;"
+           "INSERT OR IGNORE INTO main.Names (Name) "
+           "SELECT Name FROM src.Names;"
+           "DROP TABLE IF EXISTS temp.NameMap;"
+           "CREATE TEMP TABLE NameMap(Src INTEGER PRIMARY KEY, Dst INTEGER);"
+           "INSERT INTO temp.NameMap SELECT s.ID, m.ID FROM src.Names s "
+           "JOIN main.Names m ON m.Name = s.Name;");
+  // a NULL ParentID stays NULL
+  exec(db, "INSERT INTO main.SpanRecords "
+           "(ID, Rank, Tid, NameID, KindID, Device, ParentID, Depth, Start, "
+           "Stop) "
+           "SELECT s.ID + " +
+               spanOffset +
+               ", s.Rank, s.Tid, n.Dst, s.KindID, s.Device, s.ParentID + " +
+               spanOffset +
+               ", s.Depth, s.Start, s.Stop "
+               "FROM src.SpanRecords s JOIN temp.NameMap n ON n.Src = s.NameID "
+               "ORDER BY s.ID;");
+  exec(db, "INSERT INTO main.DeepCopyRecords "
+           "(ID, SrcSpaceID, SrcNameID, DstSpaceID, DstNameID, Bytes) "
+           "SELECT s.ID + " +
+               spanOffset +
+               ", ss.Dst, sn.Dst, ds.Dst, dn.Dst, s.Bytes "
+               "FROM src.DeepCopyRecords s "
+               "JOIN temp.NameMap ss ON ss.Src = s.SrcSpaceID "
+               "JOIN temp.NameMap sn ON sn.Src = s.SrcNameID "
+               "JOIN temp.NameMap ds ON ds.Src = s.DstSpaceID "
+               "JOIN temp.NameMap dn ON dn.Src = s.DstNameID "
+               "ORDER BY s.ID;");
+  exec(db, "INSERT INTO main.EventRecords "
+           "(Rank, Tid, NameID, KindID, Device, ParentID, Depth, Time) "
+           "SELECT s.Rank, s.Tid, n.Dst, s.KindID, s.Device, s.ParentID + " +
+               spanOffset +
+               ", s.Depth, s.Time "
+               "FROM src.EventRecords s JOIN temp.NameMap n ON n.Src = s.NameID "
+               "ORDER BY s.ID;");
+  exec(db, "INSERT INTO main.RegionPaths (ID, ParentID, NameID) "
+           "SELECT s.ID + " +
+               pathOffset +
+               ", CASE WHEN s.ParentID = 0 THEN 0 ELSE s.ParentID + " +
+               pathOffset +
+               " END, n.Dst "
+               "FROM src.RegionPaths s "
+               "JOIN temp.NameMap n ON n.Src = s.NameID;");
+  exec(db, "INSERT INTO main.KernelStats (ID, Rank, NameID, KindID, Device, "
+           "PathID, Count, Total, Min, Max, Mean) "
+           "SELECT s.ID + " +
+               statOffset + ", s.Rank, n.Dst, s.KindID, s.Device, " + pathID +
+               ", s.Count, s.Total, s.Min, s.Max, s.Mean "
+               "FROM src.KernelStats s "
+               "JOIN temp.NameMap n ON n.Src = s.NameID;");
+  exec(db, "INSERT INTO main.KernelHistograms (StatID, Lower, Upper, Count) "
+           "SELECT StatID + " +
+               statOffset + ", Lower, Upper, Count FROM src.KernelHistograms;");
+  exec(db, "INSERT INTO main.Sampling (Rank, NameID, Seen, Recorded) "
+           "SELECT s.Rank, n.Dst, s.Seen, s.Recorded FROM src.Sampling s "
+           "JOIN temp.NameMap n ON n.Src = s.NameID;"
+           "INSERT INTO main.KtsStats SELECT * FROM src.KtsStats;");
+  exec(db, "INSERT INTO main.MemorySpaces SELECT s.Rank, n.Dst, s.PeakBytes, "
+           "s.PeakTime, s.FinalBytes, s.Allocations, s.Deallocations "
+           "FROM src.MemorySpaces s JOIN temp.NameMap n ON n.Src = s.SpaceID;"
+           "INSERT INTO main.MemoryTimeline SELECT s.Rank, n.Dst, s.Time, "
+           "s.Bytes, s.MaxBytes FROM src.MemoryTimeline s "
+           "JOIN temp.NameMap n ON n.Src = s.SpaceID;"
+           "INSERT INTO main.MemoryPeaks SELECT s.Rank, sp.Dst, n.Dst, "
+           "s.Count, s.Bytes FROM src.MemoryPeaks s "
+           "JOIN temp.NameMap sp ON sp.Src = s.SpaceID "
+           "JOIN temp.NameMap n ON n.Src = s.NameID;"
+           "INSERT INTO main.MemoryLeaks SELECT s.Rank, sp.Dst, n.Dst, "
+           "s.Address, s.Bytes, s.Time FROM src.MemoryLeaks s "
+           "JOIN temp.NameMap sp ON sp.Src = s.SpaceID "
+           "JOIN temp.NameMap n ON n.Src = s.NameID;"
+           "INSERT INTO main.Sections SELECT s.Rank, n.Dst, s.Count, s.Total, "
+           "s.Min, s.Max, s.Mean FROM src.Sections s "
+           "JOIN temp.NameMap n ON n.Src = s.NameID;"
+           "INSERT INTO main.ClockOffsets SELECT * FROM src.ClockOffsets;");
+  exec(db, "COMMIT;");
+
+  exec(db, "DETACH src;");
+}
+
+// merge inputs[begin, end) into a new database at path
+static void merge_range(const std::string &path,
+                        const std::vector<std::string> &inputs, size_t begin,
+                        size_t end) {
+  sqlite3 *db = open_output(path);
+  for (size_t i = begin; i < end; ++i) {
+    merge_one(db, inputs[i]);
+  }
+  sqlite3_close(db);
+}
+
+int main(int argc, char **argv) {
+
+  std::string outPath = "kts_merged.sqlite";
+  size_t numThreads = std::thread::hardware_concurrency();
+  std::vector<std::string> inputs;
+  for (int i = 1; i < argc; ++i) {
+    if (0 == std::strcmp(argv[i], "-o") && i + 1 < argc) {
+      outPath = argv[++i];
+    } else if (0 == std::strcmp(argv[i], "-j") && i + 1 < argc) {
+      numThreads = std::strtoul(argv[++i], nullptr, 10);
+    } else if (0 == std::strcmp(argv[i], "-h") ||
+               0 == std::strcmp(argv[i], "--help")) {
+      help(std::cout);
+      return 0;
+    } else {
+      inputs.push_back(argv[i]);
+    }
+  }
+  if (inputs.empty()) {
+    help(std::cerr);
+    return 1;
+  }
+  for (const std::string &input : inputs) {
+    if (input == outPath) {
+      std::cerr << "output " << outPath << " is also an input\n";
+      return 1;
+    }
+  }
+  if (numThreads < 1) {
+    numThreads = 1;
+  }
+
+  // Each thread merges a contiguous group of inputs into a partial database,
+  // which are then merged in order. With one group there is nothing to
+  // combine, so it is merged into the output directly
+  const size_t numGroups = std::min(numThreads, (inputs.size() + 1) / 2);
+  std::vector<std::string> parts;
+  if (numGroups > 1) {
+    std::cerr << "merge " << inputs.size() << " databases in " << numGroups
+              << " groups\n";
+    std::vector<std::thread> threads;
+    for (size_t g = 0; g < numGroups; ++g) {
+      parts.push_back(outPath + ".part" + std::to_string(g));
+      const size_t begin = inputs.size() * g / numGroups;
+      const size_t end = inputs.size() * (g + 1) / numGroups;
+      threads.emplace_back(merge_range, parts.back(), std::cref(inputs), begin,
+                           end);
+    }
+    for (std::thread &t : threads) {
+      t.join();
+    }
+  } else {
+    parts = inputs;
+  }
+
+  std::cerr << "merge " << parts.size() << " databases into " << outPath
+            << "\n";
+  sqlite3 *db = open_output(outPath);
+  for (const std::string &part : parts) {
+    merge_one(db, part);
+  }
+  exec(db, "INSERT OR REPLACE INTO Meta (Key, Value) VALUES "
+           "('merged_inputs', '" +
+               std::to_string(inputs.size()) + "');");
+
+  std::cerr << "create indexes\n";
+  if (!schema::create_indexes(db)) {
+    return 1;
+  }
+  sqlite3_close(db);
+
+  if (numGroups > 1) {
+    for (const std::string &part : parts) {
+      std::remove(part.c_str());
+    }
+  }
+  std::cerr << "wrote " << outPath << "\n";
+}
@@ -0,0 +1,269 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <sqlite3.h>
+
+#include "kts_histogram.hpp"
+#include "kts_report.hpp"
+#include "kts_schema.hpp"
+#include "kts_trace_reader.hpp"
+
+static void help(std::ostream &os) {
+  os << "usage: kts-summary [options] trace.sqlite...\n"
+     << "Summarize kernels, fences and regions across rank databases\n"
+     << "  --sort total|count|mean|p99|name  order of the rows (total)\n"
+     << "  --top N        print the first N rows, 0 for all (20)\n"
+     << "  --kind KIND    only this kind, e.g. REGION or PARALLEL_FOR\n"
+     << "  --name REGEX   only names matching REGEX\n"
+     << "  --format table|csv|json  (table)\n"
+     << "  -j N           reader threads (all cores)\n";
+}
+
+struct Stats {
+  std::string name;
+  std::string kind;
+  uint64_t count = 0;
+  double total = 0; // seconds
+  schema::Histogram hist; // ns
+
+  void merge(const Stats &other) {
+    count += other.count;
+    total += other.total;
+    hist.merge(other.hist);
+  }
+};
+
+// stats by kind and name, and the summed run time of the ranks read
+struct Summary {
+  std::unordered_map<std::string, Stats> stats;
+  double runtime = 0;
+
+  Stats &at(const std::string &kind, const std::string &name) {
+    Stats &s = stats[kind + '\0' + name];
+    if (s.name.empty() && s.kind.empty()) {
+      s.kind = kind;
+      s.name = name;
+    }
+    return s;
+  }
+
+  void merge(Summary &other) {
+    for (auto &kv : other.stats) {
+      Stats &s = stats[kv.first];
+      if (0 == s.count && s.name.empty()) {
+        s.name = kv.second.name;
+        s.kind = kv.second.kind;
+      }
+      s.merge(kv.second);
+    }
+    runtime += other.runtime;
+  }
+};
+
+static uint64_t to_ns(double seconds) {
+  return seconds > 0 ? uint64_t(std::llround(seconds * 1e9)) : 0;
+}
+
+// Add the spans, aggregate-mode KernelStats and Sections of one database to
+// summary. Spans are read by ID and looked up through a per-database table, so
+// the only strings built are one per distinct name.
+static void read_trace(Summary &summary, const std::string &path) {
+  sqlite3 *db = nullptr;
+  if (SQLITE_OK !=
+      sqlite3_open_v2(path.c_str(), &db, SQLITE_OPEN_READONLY, nullptr)) {
+    std::cerr << "Can't open database: " << sqlite3_errmsg(db) << std::endl;
+    exit(1);
+  }
+  const std::vector<std::string> names =
+      schema::read_dictionary(db, "SELECT ID, Name FROM Names;");
+  const std::vector<std::string> kinds =
+      schema::read_dictionary(db, "SELECT ID, Name FROM Kinds;");
+
+  // stats for each (KindID, NameID) seen in this database
+  std::unordered_map<uint64_t, Stats *> local;
+  auto stats = [&](int64_t kindID, int64_t nameID) -> Stats & {
+    const uint64_t key = (uint64_t(kindID) << 32) | uint32_t(nameID);
+    auto it = local.find(key);
+    if (it == local.end()) {
+      Stats &s = summary.at(schema::lookup(kinds, kindID),
+                            schema::lookup(names, nameID));
+      it = local.emplace(key, &s).first;
+    }
+    return *it->second;
+  };
+
+  // every section is counted in the Sections table below, so SECTION spans
+  // (KTS_SECTION_SPANS=1) only add their durations to the percentiles
+  const int64_t sectionKind = int64_t(schema::Kind::SECTION);
+  sqlite3_stmt *stmt = schema::prepare_query(
+      db, "SELECT KindID, NameID, Stop - Start FROM SpanRecords;");
+  while (SQLITE_ROW == sqlite3_step(stmt)) {
+    const int64_t kindID = sqlite3_column_int64(stmt, 0);
+    Stats &s = stats(kindID, sqlite3_column_int64(stmt, 1));
+    const int64_t ns = sqlite3_column_int64(stmt, 2);
+    if (kindID != sectionKind) {
+      s.count += 1;
+      s.total += ns * 1e-9;
+    }
+    s.hist.add(ns > 0 ? uint64_t(ns) : 0);
+  }
+  sqlite3_finalize(stmt);
+
+  // aggregate mode, or records folded in when a buffer overflowed
+  std::unordered_map<int64_t, Stats *> statIDs;
+  stmt = schema::prepare_query(
+      db, "SELECT ID, KindID, NameID, Count, Total FROM KernelStats;");
+  while (SQLITE_ROW == sqlite3_step(stmt)) {
+    Stats &s = stats(sqlite3_column_int64(stmt, 1),
+                     sqlite3_column_int64(stmt, 2));
+    s.count += sqlite3_column_int64(stmt, 3);
+    s.total += sqlite3_column_double(stmt, 4);
+    statIDs[sqlite3_column_int64(stmt, 0)] = &s;
+  }
+  sqlite3_finalize(stmt);
+  stmt = schema::prepare_query(
+      db, "SELECT StatID, Lower, Count FROM KernelHistograms;");
+  while (SQLITE_ROW == sqlite3_step(stmt)) {
+    auto it = statIDs.find(sqlite3_column_int64(stmt, 0));
+    if (it != statIDs.end()) {
+      it->second->hist.add(to_ns(sqlite3_column_double(stmt, 1)),
+                           sqlite3_column_int64(stmt, 2));
+    }
+  }
+  sqlite3_finalize(stmt);
+
+  stmt = schema::prepare_query(
+      db, "SELECT NameID, Count, Total FROM Sections;");
+  while (SQLITE_ROW == sqlite3_step(stmt)) {
+    Stats &s = stats(sectionKind, sqlite3_column_int64(stmt, 0));
+    s.count += sqlite3_column_int64(stmt, 1);
+    s.total += sqlite3_column_double(stmt, 2);
+  }
+  sqlite3_finalize(stmt);
+
+  // The run time of each rank in the database: the profiled duration, or
+  // failing that its last recorded time. A merged database keeps the duration
+  // of only one of its inputs, which stands in for all of its ranks
+  stmt = schema::prepare_query(
+      db, "SELECT IFNULL(SUM(MAX(Last, Duration)), Duration) "
+          "FROM (SELECT IFNULL((SELECT CAST(Value AS REAL) FROM Meta "
+          "WHERE Key = 'duration'), 0) AS Duration) "
+          "LEFT JOIN (SELECT MAX(Time) * 1e-9 AS Last FROM ("
+          "SELECT Rank, Stop AS Time FROM SpanRecords "
+          "UNION ALL SELECT Rank, Time FROM EventRecords "
+          "UNION ALL SELECT Rank, 0 FROM KernelStats "
+          "UNION ALL SELECT Rank, 0 FROM Sections) GROUP BY Rank);");
+  if (SQLITE_ROW == sqlite3_step(stmt)) {
+    summary.runtime += sqlite3_column_double(stmt, 0);
+  }
+  sqlite3_finalize(stmt);
+
+  sqlite3_close(db);
+}
+
+// a row of the report
+struct Row {
+  const Stats *stats;
+  double mean;
+  double p50, p95, p99;
+  double share; // of the ranks' summed run time; over 1 with many threads
+};
+
+static void write_table(const std::vector<Row> &rows) {
+  std::printf("%-16s %10s %12s %12s %12s %12s %12s %7s  %s\n", "Kind", "Count",
+              "Total(s)", "Mean(s)", "p50(s)", "p95(s)", "p99(s)", "Share",
+              "Name");
+  for (const Row &r : rows) {
+    std::printf("%-16s %10llu %12.6f %12.6g %12.6g %12.6g %12.6g %6.2f%%  %s\n",
+                r.stats->kind.c_str(),
+                static_cast<unsigned long long>(r.stats->count),
+                r.stats->total, r.mean, r.p50, r.p95, r.p99, 100 * r.share,
+                r.stats->name.c_str());
+  }
+}
+
+static void write_csv(const std::vector<Row> &rows) {
+  std::printf("Kind,Name,Count,Total,Mean,P50,P95,P99,Share\n");
+  for (const Row &r : rows) {
+    std::printf("%s,%s,%llu,%.9g,%.9g,%.9g,%.9g,%.9g,%.6g\n",
+                r.stats->kind.c_str(),
+                schema::csv_string(r.stats->name).c_str(),
+                static_cast<unsigned long long>(r.stats->count),
+                r.stats->total, r.mean, r.p50, r.p95, r.p99, r.share);
+  }
+}
+
+static void write_json(const std::vector<Row> &rows, double runtime) {
+  std::printf("{\"runtime\":%.9g,\"rows\":[", runtime);
+  for (size_t i = 0; i < rows.size(); ++i) {
+    const Row &r = rows[i];
+    std::printf("%s\n{\"kind\":%s,\"name\":%s,\"count\":%llu,\"total\":%.9g,"
+                "\"mean\":%.9g,\"p50\":%.9g,\"p95\":%.9g,\"p99\":%.9g,"
+                "\"share\":%.6g}",
+                i ? "," : "", schema::json_string(r.stats->kind).c_str(),
+                schema::json_string(r.stats->name).c_str(),
+                static_cast<unsigned long long>(r.stats->count),
+                r.stats->total, r.mean, r.p50, r.p95, r.p99, r.share);
+  }
+  std::printf("\n]}\n");
+}
+
+int main(int argc, char **argv) {
+
+  schema::ReportOptions options;
+  int status = 0;
+  if (!schema::parse_report_options(argc, argv,
+                                    {"total", "count", "mean", "p99", "name"},
+                                    help, options, status)) {
+    return status;
+  }
+
+  // each thread summarizes the inputs it takes into its own Summary
+  const std::vector<std::string> &inputs = options.inputs;
+  Summary summary = schema::read_in_parallel<Summary>(
+      inputs.size(), options.numThreads,
+      [&](Summary &s, size_t i) { read_trace(s, inputs[i]); });
+
+  std::vector<Row> rows;
+  for (const auto &kv : summary.stats) {
+    const Stats &s = kv.second;
+    if (0 == s.count || !options.matches(s.kind, s.name)) {
+      continue;
+    }
+    rows.push_back(Row{&s, s.total / s.count, s.hist.quantile(0.50) * 1e-9,
+                       s.hist.quantile(0.95) * 1e-9,
+                       s.hist.quantile(0.99) * 1e-9,
+                       summary.runtime > 0 ? s.total / summary.runtime : 0});
+  }
+
+  auto by = [&](const Row &a, const Row &b) {
+    if (options.sort == "count") {
+      return a.stats->count > b.stats->count;
+    } else if (options.sort == "mean") {
+      return a.mean > b.mean;
+    } else if (options.sort == "p99") {
+      return a.p99 > b.p99;
+    } else if (options.sort == "name") {
+      return a.stats->name < b.stats->name;
+    }
+    return a.stats->total > b.stats->total;
+  };
+  std::sort(rows.begin(), rows.end(), by);
+  if (options.top && rows.size() > options.top) {
+    rows.resize(options.top);
+  }
+
+  if (options.format == "csv") {
+    write_csv(rows);
+  } else if (options.format == "json") {
+    write_json(rows, summary.runtime);
+  } else {
+    write_table(rows);
+  }
+}
@@ -1,12 +1,16 @@
 
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
-#include <condition_variable>
-#include <functional>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
 #include <iostream>
-#include <mutex>
-#include <queue>
-#include <sstream>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <memory>
 #include <string>
 #include <thread>
 #include <unordered_map>
@@ -17,115 +21,279 @@
 #include <dlfcn.h>
 
 #include "kts.hpp"
+#include "kts_aggregate.hpp"
+#include "kts_clock.hpp"
+#include "kts_env.hpp"
+#include "kts_filter.hpp"
+#include "kts_memory.hpp"
+#include "kts_names.hpp"
+#include "kts_overhead.hpp"
 #include "kts_pid.hpp"
+#include "kts_queue.hpp"
+#include "kts_rank_summary.hpp"
 #include "kts_schema.hpp"
+#include "kts_sections.hpp"
+#include "kts_timer.hpp"
+#include "kts_trace_log.hpp"
 
 using Clock = std::chrono::steady_clock;
-using Duration = std::chrono::duration<double>;
 using TimePoint = std::chrono::time_point<Clock>;
 
 namespace lib {
 
-static uint64_t spanID = 0;
 static sqlite3 *db = nullptr;
-static TimePoint profileStart; // when the profiling library was initialized, to
-                               // normalize times
+static uint64_t profileStartNs; // when the profiling library was initialized,
+                                 // to normalize times
 static int rank = -1;
 
-struct Span {
-  int rank;
-  std::string name;
-  std::string kind;
-  Duration start;
-
-  Span() = default;
-  Span(int _rank, const std::string &_name, const std::string &_kind,
-       const Duration &_start)
-      : rank(_rank), name(_name), kind(_kind), start(_start) {}
-};
+// ns since init on the selected timer
+static int64_t now() { return int64_t(now_ns() - profileStartNs); }
+// KTS_MODE=aggregate: keep per-kernel statistics instead of writing records
+static bool aggregateMode = false;
+// KTS_SECTION_SPANS: also record every stop of a profile section as a span
+static bool sectionSpans = false;
+static bool globalFences = false;
+// KTS_CLOCK_SYNC=wall, or MPI was not running at init
+static bool clockWall = false;
+
+using schema::Kind;
+
+// devID for kinds that do not run on a device
+static constexpr uint32_t NO_DEVICE = std::numeric_limits<uint32_t>::max();
 
-struct Event {
-  int rank;
-  std::string name;
-  std::string kind;
+// parent of spans and events outside of any recorded region
+static constexpr uint64_t NO_PARENT = std::numeric_limits<uint64_t>::max();
 
-  Event() = delete;
-  Event(int _rank, const std::string &_name, const std::string &_kind)
-      : rank(_rank), name(_name), kind(_kind) {}
+struct Span {
+  NameID name;
+  Kind kind;
+  bool recorded; // false for regions rejected by KTS_INCLUDE / KTS_EXCLUDE
+  uint32_t devID;
+  uint32_t tid;
+  uint32_t depth; // the number of recorded regions enclosing this one
+  PathID path;    // the enclosing regions, in aggregate mode
+  PathID inner;   // for regions, the path of the region itself
+  uint64_t id;
+  uint64_t parent; // the innermost recorded region enclosing this one
+  int64_t start;   // ns since init
 };
 
-static std::unordered_map<uint64_t, Span> spans;
-static std::vector<Span> regions;
-static const char *KIND_PARFOR = "PARALLEL_FOR";
-static const char *KIND_PARRED = "PARALLEL_REDUCE";
-static const char *KIND_PARSCAN = "PARALLEL_SCAN";
-static const char *KIND_REGION = "REGION";
-static const char *KIND_DEEPCOPY = "DEEPCOPY";
-static const char *KIND_FENCE = "FENCE";
-static const char *KIND_ALLOC = "ALLOC";
-static const char *KIND_DEALLOC = "DEALLOC";
-static const char *KIND_EVENT = "EVENT";
-
-class Worker {
+// Spans that have begun but not ended, keyed by kID. Open addressing over a
+// fixed array so begin/end never allocate. IDs are handed out sequentially,
+// so kID & mask almost always lands on a free slot.
+template <size_t CAPACITY> class OpenSpans {
 public:
-  Worker() : stop_(true) {}
+  bool insert(uint64_t kID, const Span &span) {
+    for (size_t i = 0; i < CAPACITY; ++i) {
+      Slot &slot = slots_[(kID + i) & MASK];
+      if (slot.kID == EMPTY || slot.kID == TOMBSTONE) {
+        slot.kID = kID;
+        slot.span = span;
+        return true;
+      }
+    }
+    return false;
+  }
 
-  template <typename F> void add_job(F &&f) {
-    {
-      std::unique_lock<std::mutex> lock(mutex_);
-      jobs_.emplace_back(std::forward<F>(f));
+  // moves the span for kID into span and frees its slot
+  bool take(uint64_t kID, Span &span) {
+    for (size_t i = 0; i < CAPACITY; ++i) {
+      Slot &slot = slots_[(kID + i) & MASK];
+      if (slot.kID == kID) {
+        span = slot.span;
+        slot.kID = TOMBSTONE;
+        return true;
+      } else if (slot.kID == EMPTY) {
+        return false;
+      }
     }
-    cv_.notify_one();
+    return false;
   }
 
-  void start() {
-    thread_ = std::thread(&Worker::loop, this);
-    stop_ = false;
+private:
+  static constexpr uint64_t EMPTY = std::numeric_limits<uint64_t>::max();
+  static constexpr uint64_t TOMBSTONE = EMPTY - 1;
+  static constexpr size_t MASK = CAPACITY - 1;
+
+  struct Slot {
+    uint64_t kID = EMPTY;
+    Span span;
+  };
+  Slot slots_[CAPACITY];
+};
+
+// Span IDs are unique across threads. Each thread takes them from the shared
+// counter a block at a time, so the counter is touched once per ID_BLOCK spans
+static constexpr uint64_t ID_BLOCK = 1024;
+static std::atomic<uint64_t> nextIDBlock{0};
+
+// Open spans are split into shards by ID block, each behind its own spinlock.
+// Threads draw from different blocks, so they rarely share a shard.
+class ShardedOpenSpans {
+public:
+  bool insert(uint64_t kID, const Span &span) {
+    Shard &s = shard(kID);
+    SpinLock lock(s.lock);
+    return s.spans.insert(kID, span);
   }
 
-  void join() {
-    std::cerr << __FILE__ << ":" << __LINE__ << " flush remaining records...\n";
-    {
-      std::unique_lock<std::mutex> lock(mutex_);
-      stop_ = true;
-    }
-    cv_.notify_one();
-    thread_.join();
+  bool take(uint64_t kID, Span &span) {
+    Shard &s = shard(kID);
+    SpinLock lock(s.lock);
+    return s.spans.take(kID, span);
   }
 
 private:
-  void loop() {
+  static constexpr size_t NUM_SHARDS = 32;
 
-    // std::cerr << __FILE__ << ":" << __LINE__ << " worker loop...\n";
-    while (true) {
-      std::vector<std::function<void()>> jobs;
-      // std::cerr << __FILE__ << ":" << __LINE__ << " worker lock entry...\n";
-      {
-        std::unique_lock<std::mutex> lock(mutex_);
-        cv_.wait(lock, [this] { return !jobs_.empty() || stop_; });
-        if (stop_ && jobs_.empty()) {
-          return;
-        }
-        // quickly take all existing jobs
-        std::swap(jobs, jobs_);
-      }
-      // std::cerr << __FILE__ << ":" << __LINE__ << " worker release... " <<
-      // jobs.size() << "\n";
-      for (const auto &job : jobs) {
-        job();
+  struct SpinLock {
+    explicit SpinLock(std::atomic_flag &flag) : flag_(flag) {
+      while (flag_.test_and_set(std::memory_order_acquire)) {
+        std::this_thread::yield();
       }
     }
+    ~SpinLock() { flag_.clear(std::memory_order_release); }
+    std::atomic_flag &flag_;
+  };
+
+  struct alignas(64) Shard {
+    std::atomic_flag lock = ATOMIC_FLAG_INIT;
+    OpenSpans<ID_BLOCK> spans;
+  };
+
+  Shard &shard(uint64_t kID) { return shards_[(kID / ID_BLOCK) % NUM_SHARDS]; }
+
+  Shard shards_[NUM_SHARDS];
+};
+
+static ShardedOpenSpans spans;
+static std::atomic<uint32_t> nextTid{0};
+
+// names already written to the Names table, indexed by NameID
+static std::vector<bool> namesWritten;
+
+// KTS_OUTPUT=log: the writer thread appends records to this instead of the
+// record tables. Only the writer thread touches it while it runs
+static std::unique_ptr<schema::LogWriter> traceLog;
+// names already in traceLog, indexed by NameID
+static std::vector<bool> namesLogged;
+
+// KTS_OUTPUT=log with KTS_MPI_SUMMARY: the logged spans of each name and kind,
+// which are not in SpanRecords at finalize. Keyed by NameID << 8 | kind, and
+// only touched by the writer thread while it runs
+struct LoggedSpans {
+  uint64_t count = 0;
+  int64_t total = 0; // ns
+  int64_t min = std::numeric_limits<int64_t>::max();
+  int64_t max = 0;
+};
+static bool summarizeLog = false;
+static std::unordered_map<uint64_t, LoggedSpans> loggedSpans;
+
+// what the callbacks hand to the writer thread, one cache line each
+struct Record {
+  enum class Type : uint8_t { SPAN, EVENT };
+
+  Type type;
+  Kind kind;
+  uint16_t depth; // regions do not nest anywhere near 65536 deep
+  uint32_t devID; // for deep copies, which have no device, the destination space
+  NameID name;    // for deep copies, the destination label
+  uint32_t tid;
+  uint64_t id; // for spans only
+  uint64_t parent;
+  int64_t start; // ns since init. For events, the event time
+  int64_t stop;
+  // deep copies only
+  NameID srcSpace;
+  NameID srcName;
+  uint64_t bytes;
+};
+static_assert(sizeof(Record) == 64, "Record should fill one cache line");
+
+// bytes of records buffered per producer thread, unless KTS_BUFFER_BYTES
+static constexpr size_t BUFFER_BYTES = size_t(2) << 20;
+static ThreadQueues<Record> queues(BUFFER_BYTES / sizeof(Record));
+
+// what a callback does when its queue is full (KTS_OVERFLOW)
+enum class Overflow {
+  BLOCK,    // wait for the writer thread to make room
+  DROP,     // discard the new record
+  AGGREGATE // fold the new record into KernelStats instead
+};
+static Overflow overflowPolicy = Overflow::BLOCK;
+
+// only touched when a queue is full
+static std::atomic<uint64_t> droppedRecords{0};
+static std::atomic<uint64_t> delayedRecords{0};
+static std::atomic<uint64_t> delayNs{0};
+static std::atomic<uint64_t> degradedRecords{0};
+
+// A deep copy that has begun but not ended. span.name and span.devID hold the
+// destination label and space
+struct OpenCopy {
+  Span span;
+  NameID srcSpace;
+  NameID srcName;
+  NameID copy; // "src[SrcSpace]->dst[DstSpace]"
+  uint64_t bytes;
+};
+
+// State owned by each thread that makes Kokkos callbacks. The queue is held
+// until the thread exits.
+struct Producer {
+  Producer() : tid(nextTid.fetch_add(1, std::memory_order_relaxed)) {
+    regions.reserve(64);
+    copies.reserve(8);
+  }
+  ~Producer() {
+    if (queue) {
+      queues.release(queue);
+    }
   }
 
-  std::thread thread_;
-  std::vector<std::function<void()>> jobs_;
-  std::condition_variable cv_;
-  std::mutex mutex_;
+  uint64_t next_span_id() {
+    if (nextID == endID) {
+      nextID = nextIDBlock.fetch_add(1, std::memory_order_relaxed) * ID_BLOCK;
+      endID = nextID + ID_BLOCK;
+    }
+    return nextID++;
+  }
 
-  bool stop_;
+  ThreadQueues<Record>::Queue *queue = nullptr;
+  const uint32_t tid; // a small index, in order of first callback
+  uint64_t nextID = 0;
+  uint64_t endID = 0;
+  std::vector<Span> regions;
+  std::vector<OpenCopy> copies; // Kokkos does not nest them, but be safe
 };
+static thread_local Producer producer;
+
+// The name a deep copy is recorded under, "src[SrcSpace]->dst[DstSpace]".
+// Copies repeat between the same few views, so the calling thread keeps the
+// latest few and only formats a name it has not seen recently
+static NameID copy_name(NameID srcSpace, NameID srcName, NameID dstSpace,
+                        NameID dstName) {
+  struct Entry {
+    NameID srcSpace, srcName, dstSpace, dstName, copy;
+    bool valid;
+  };
+  static thread_local Entry cache[16] = {};
+  Entry &e = cache[(srcName * 31 + dstName * 7 + srcSpace + dstSpace) & 15];
+  if (e.valid && e.srcSpace == srcSpace && e.srcName == srcName &&
+      e.dstSpace == dstSpace && e.dstName == dstName) {
+    return e.copy;
+  }
+  std::string name = name_of(srcName);
+  name.append("[").append(name_of(srcSpace)).append("]->");
+  name.append(name_of(dstName));
+  name.append("[").append(name_of(dstSpace)).append("]");
+  e = Entry{srcSpace, srcName, dstSpace, dstName,
+            intern_name(name.c_str()), true};
+  return e.copy;
+}
 
-static Worker worker;
+static void write_record(const Record &record);
 
 static void begin_transaction() {
   char *errMsg = 0;
@@ -149,18 +317,532 @@ static void commit_transaction() {
   }
 }
 
+// the signals that flush buffered records before the process dies
+static const int FLUSH_SIGNALS[] = {SIGTERM, SIGINT, SIGHUP, SIGQUIT,
+                                    SIGABRT, SIGSEGV, SIGBUS, SIGFPE,
+                                    SIGILL,  SIGXCPU};
+
+// Drains the per-thread queues into the database. The transaction opened in
+// init() is committed and reopened every commitRecords records or
+// commitInterval, whichever comes first, so a killed job keeps most of its
+// trace.
+class Writer {
+public:
+  void start(uint64_t commitRecords, std::chrono::milliseconds commitInterval) {
+    commitRecords_ = commitRecords;
+    commitInterval_ = commitInterval;
+    stop_.store(false, std::memory_order_relaxed);
+    // A process-directed signal goes to any thread that does not block it.
+    // The handler waits for this thread to flush, so this thread starts with
+    // the signals blocked and they go to one of the others
+    sigset_t blocked, old;
+    sigemptyset(&blocked);
+    for (int sig : FLUSH_SIGNALS) {
+      sigaddset(&blocked, sig);
+    }
+    pthread_sigmask(SIG_BLOCK, &blocked, &old);
+    thread_ = std::thread(&Writer::loop, this);
+    pthread_sigmask(SIG_SETMASK, &old, nullptr);
+    id_ = thread_.get_id();
+    running_.store(true, std::memory_order_release);
+  }
+
+  void join() {
+    std::cerr << __FILE__ << ":" << __LINE__ << " flush remaining records...\n";
+    stop_.store(true, std::memory_order_release);
+    thread_.join();
+    running_.store(false, std::memory_order_release);
+  }
+
+  // safe to call from any thread
+  bool running() const { return running_.load(std::memory_order_acquire); }
+
+  bool is_writer_thread() const {
+    return running() && std::this_thread::get_id() == id_;
+  }
+
+  // Ask the writer thread to drain and commit what is buffered, and wait up to
+  // timeout for it. Only waits on atomics and sleeps, so it can be used from a
+  // signal handler.
+  bool flush(std::chrono::milliseconds timeout) {
+    if (!running() || is_writer_thread()) {
+      return false;
+    }
+    const uint64_t ticket =
+        flushRequested_.fetch_add(1, std::memory_order_acq_rel) + 1;
+    for (auto waited = std::chrono::milliseconds(0); waited < timeout;
+         waited += std::chrono::milliseconds(1)) {
+      if (flushDone_.load(std::memory_order_acquire) >= ticket) {
+        return true;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return false;
+  }
+
+private:
+  // drain every queue once, noting how full they were and how long records
+  // waited for the writer
+  size_t drain() {
+    const uint64_t depth = queues.max_size();
+    const int64_t passStart = now();
+    const size_t n = queues.drain([passStart](const Record &record) {
+      note_drain_latency(passStart - record.stop);
+      write_record(record);
+    });
+    if (n) {
+      note_drain(depth, n, now() - passStart);
+    }
+    return n;
+  }
+
+  void commit() {
+    const int64_t start = now();
+    commit_transaction();
+    begin_transaction();
+    note_commit(now() - start);
+  }
+
+  void loop() {
+    uint64_t uncommitted = 0;
+    TimePoint lastCommit = Clock::now();
+    while (!stop_.load(std::memory_order_acquire)) {
+      recalibrate_timer();
+      const size_t n = drain();
+      uncommitted += n;
+
+      const uint64_t requested = flushRequested_.load(std::memory_order_acquire);
+      if (requested != flushDone_.load(std::memory_order_relaxed)) {
+        while (size_t m = drain()) {
+          uncommitted += m;
+        }
+        commit();
+        uncommitted = 0;
+        lastCommit = Clock::now();
+        flushDone_.store(requested, std::memory_order_release);
+        continue;
+      }
+
+      if (uncommitted) {
+        const TimePoint now = Clock::now();
+        if (uncommitted >= commitRecords_ ||
+            now - lastCommit >= commitInterval_) {
+          commit();
+          uncommitted = 0;
+          lastCommit = now;
+        }
+      }
+
+      if (0 == n) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    }
+    // producers are done, take whatever is left
+    while (drain()) {
+    }
+  }
+
+  std::thread thread_;
+  std::thread::id id_;
+  std::atomic<bool> stop_{true};
+  std::atomic<bool> running_{false};
+  std::atomic<uint64_t> flushRequested_{0};
+  std::atomic<uint64_t> flushDone_{0};
+  uint64_t commitRecords_;
+  std::chrono::milliseconds commitInterval_;
+};
+
+static Writer writer;
+
+// how long a fatal signal waits for buffered records to be committed
+static constexpr std::chrono::milliseconds SIGNAL_FLUSH_TIMEOUT(5000);
+static struct sigaction oldActions[std::size(FLUSH_SIGNALS)];
+static bool signalHandlersInstalled = false;
+
+// commit what is buffered, then let the previous handler (or the default
+// action) deal with the signal
+static void flush_on_signal(int sig) {
+  writer.flush(SIGNAL_FLUSH_TIMEOUT);
+  for (size_t i = 0; i < std::size(FLUSH_SIGNALS); ++i) {
+    if (FLUSH_SIGNALS[i] == sig) {
+      sigaction(sig, &oldActions[i], nullptr);
+    }
+  }
+  raise(sig);
+}
+
+static void install_signal_handlers() {
+  struct sigaction action = {};
+  action.sa_handler = flush_on_signal;
+  sigemptyset(&action.sa_mask);
+  action.sa_flags = SA_RESETHAND;
+  for (size_t i = 0; i < std::size(FLUSH_SIGNALS); ++i) {
+    sigaction(FLUSH_SIGNALS[i], &action, &oldActions[i]);
+  }
+  signalHandlersInstalled = true;
+}
+
+static void uninstall_signal_handlers() {
+  if (!signalHandlersInstalled) {
+    return;
+  }
+  signalHandlersInstalled = false;
+  for (size_t i = 0; i < std::size(FLUSH_SIGNALS); ++i) {
+    sigaction(FLUSH_SIGNALS[i], &oldActions[i], nullptr);
+  }
+}
+
+// the process is exiting without kokkosp_finalize_library
+static void finalize_at_exit() {
+  if (db && !writer.is_writer_thread()) {
+    std::cerr << "KTS: exiting before finalize, committing buffered records\n";
+    finalize();
+  }
+}
+
+static void write_name(NameID name) {
+  if (name >= namesWritten.size()) {
+    namesWritten.resize(name + 1, false);
+  }
+  if (!namesWritten[name]) {
+    schema::insert(db, schema::Name{name, name_of(name)});
+    namesWritten[name] = true;
+  }
+}
+
+static int64_t device_column(uint32_t devID) {
+  return devID == NO_DEVICE ? schema::NO_DEVICE : int64_t(devID);
+}
+
+static int64_t parent_column(uint64_t parent) {
+  return parent == NO_PARENT ? schema::NO_PARENT : int64_t(parent);
+}
+
+static void write_copy(const Record &record) {
+  const NameID copy =
+      copy_name(record.srcSpace, record.srcName, record.devID, record.name);
+  for (NameID name : {copy, record.srcSpace, record.srcName, record.devID,
+                      record.name}) {
+    write_name(name);
+  }
+  schema::insert(db, schema::SpanRecord{int64_t(record.id), rank, record.tid,
+                                        copy, record.kind, schema::NO_DEVICE,
+                                        parent_column(record.parent),
+                                        record.depth, record.start,
+                                        record.stop});
+  schema::insert(db, schema::DeepCopyRecord{
+                         int64_t(record.id), record.srcSpace, record.srcName,
+                         record.devID, record.name, int64_t(record.bytes)});
+}
+
+static void log_name(NameID name) {
+  if (name >= namesLogged.size()) {
+    namesLogged.resize(name + 1, false);
+  }
+  if (!namesLogged[name]) {
+    traceLog->add_name(name, name_of(name));
+    namesLogged[name] = true;
+  }
+}
+
+static void log_record(const Record &record) {
+  schema::LogRecord r{};
+  r.kind = record.kind;
+  r.tid = record.tid;
+  r.id = int64_t(record.id);
+  r.nameID = record.name;
+  r.device = device_column(record.devID);
+  r.parentID = parent_column(record.parent);
+  r.depth = record.depth;
+  r.start = record.start;
+  r.stop = record.stop;
+  if (record.kind == Kind::DEEPCOPY) {
+    r.type = schema::LogRecord::Type::COPY;
+    r.nameID =
+        copy_name(record.srcSpace, record.srcName, record.devID, record.name);
+    r.device = schema::NO_DEVICE;
+    r.srcSpaceID = record.srcSpace;
+    r.srcNameID = record.srcName;
+    r.dstSpaceID = record.devID;
+    r.dstNameID = record.name;
+    r.bytes = int64_t(record.bytes);
+    for (NameID name : {NameID(r.nameID), record.srcSpace, record.srcName,
+                        record.devID, record.name}) {
+      log_name(name);
+    }
+  } else {
+    r.type = record.type == Record::Type::SPAN ? schema::LogRecord::Type::SPAN
+                                               : schema::LogRecord::Type::EVENT;
+    log_name(record.name);
+  }
+  traceLog->add(r);
+  if (summarizeLog && r.type != schema::LogRecord::Type::EVENT) {
+    LoggedSpans &l = loggedSpans[uint64_t(r.nameID) << 8 | uint8_t(r.kind)];
+    const int64_t ns = r.stop - r.start;
+    ++l.count;
+    l.total += ns;
+    l.min = std::min(l.min, ns);
+    l.max = std::max(l.max, ns);
+  }
+}
+
+static void write_record(const Record &record) {
+  if (traceLog) {
+    log_record(record);
+    return;
+  }
+  if (record.kind == Kind::DEEPCOPY) {
+    write_copy(record);
+    return;
+  }
+  write_name(record.name);
+  if (record.type == Record::Type::SPAN) {
+    schema::insert(db, schema::SpanRecord{
+                           int64_t(record.id), rank, record.tid, record.name,
+                           record.kind, device_column(record.devID),
+                           parent_column(record.parent), record.depth,
+                           record.start, record.stop});
+  } else {
+    schema::insert(db, schema::EventRecord{
+                           rank, record.tid, record.name, record.kind,
+                           device_column(record.devID),
+                           parent_column(record.parent), record.depth,
+                           record.start});
+  }
+}
+
+static void init_overflow() {
+  const size_t bytes = env_u64("KTS_BUFFER_BYTES", BUFFER_BYTES);
+  queues.set_capacity(std::max(bytes / sizeof(Record), size_t(1)));
+
+  const std::string policy = env_str("KTS_OVERFLOW", "block");
+  if (policy == "drop") {
+    overflowPolicy = Overflow::DROP;
+  } else if (policy == "aggregate") {
+    overflowPolicy = Overflow::AGGREGATE;
+  } else {
+    if (policy != "block") {
+      std::cerr << "KTS: unknown KTS_OVERFLOW=" << policy
+                << ", using \"block\"\n";
+    }
+    overflowPolicy = Overflow::BLOCK;
+  }
+  const std::string bytesStr = std::to_string(bytes);
+  schema::insert(db, schema::Meta{"buffer_bytes", bytesStr.c_str()});
+  schema::insert(db, schema::Meta{"overflow", policy.c_str()});
+}
+
+static void write_overflow_stats() {
+  const uint64_t dropped = droppedRecords.exchange(0);
+  const uint64_t delayed = delayedRecords.exchange(0);
+  const uint64_t delayed_ns = delayNs.exchange(0);
+  const uint64_t degraded = degradedRecords.exchange(0);
+  schema::insert(db, schema::KtsStat{rank, "dropped_records", double(dropped)});
+  schema::insert(db, schema::KtsStat{rank, "delayed_records", double(delayed)});
+  schema::insert(db, schema::KtsStat{rank, "delay_seconds", delayed_ns * 1e-9});
+  schema::insert(db,
+                 schema::KtsStat{rank, "degraded_records", double(degraded)});
+  if (dropped || delayed || degraded) {
+    std::cerr << "KTS: record buffer overflowed: " << dropped << " dropped, "
+              << delayed << " delayed, " << degraded << " aggregated\n";
+  }
+}
+
+static void write_overhead_stats() {
+  for (const OverheadStat &stat : overhead_stats(queues.capacity())) {
+    schema::insert(db, schema::KtsStat{rank, stat.name.c_str(), stat.value});
+  }
+  if (env_bool("KTS_SELF_SUMMARY", false)) {
+    std::cerr << overhead_summary(queues.capacity()) << "\n";
+  }
+}
+
+static void write_memory() {
+  const MemoryReport report = memory_report(now());
+  for (const MemorySpaceStats &s : report.spaces) {
+    write_name(s.space);
+    schema::insert(db, schema::MemorySpace{
+                           rank, s.space, int64_t(s.peakBytes), s.peakTime,
+                           int64_t(s.finalBytes), int64_t(s.allocations),
+                           int64_t(s.deallocations)});
+  }
+  for (const MemorySample &s : report.timeline) {
+    schema::insert(db, schema::MemorySample{rank, s.space, s.time,
+                                            int64_t(s.bytes),
+                                            int64_t(s.maxBytes)});
+  }
+  for (const MemoryPeakUse &p : report.peaks) {
+    write_name(p.name);
+    schema::insert(db, schema::MemoryPeak{rank, p.space, p.name,
+                                          int64_t(p.count), int64_t(p.bytes)});
+  }
+  uint64_t leakedBytes = 0;
+  for (const LiveAllocation &a : report.leaks) {
+    write_name(a.name);
+    schema::insert(db, schema::MemoryLeak{rank, a.space, a.name,
+                                          int64_t(a.address), int64_t(a.size),
+                                          a.time});
+    leakedBytes += a.size;
+  }
+  schema::insert(db, schema::KtsStat{rank, "unmatched_frees",
+                                     double(report.unmatchedFrees)});
+  if (!report.leaks.empty()) {
+    std::cerr << "KTS: " << report.leaks.size() << " allocations ("
+              << leakedBytes << " bytes) were not freed, see MemoryLeaks\n";
+  }
+}
+
+// so that analysis can rescale counts of sampled kernels
+static void write_filter_config() {
+  const FilterConfig &config = filter_config();
+  const std::string every = std::to_string(config.sampleEvery);
+  const std::string first = std::to_string(config.sampleFirst);
+  schema::insert(db, schema::Meta{"sample_every", every.c_str()});
+  schema::insert(db, schema::Meta{"sample_first", first.c_str()});
+  schema::insert(db, schema::Meta{"include", config.include.c_str()});
+  schema::insert(db, schema::Meta{"exclude", config.exclude.c_str()});
+}
+
+static void write_sample_counts() {
+  for (const SampleCount &count : sample_counts()) {
+    write_name(count.name);
+    schema::insert(db, schema::SampleCount{rank, count.name,
+                                           int64_t(count.seen),
+                                           int64_t(count.recorded)});
+  }
+  reset_filter();
+}
+
+static double seconds(uint64_t ns) { return double(ns) * 1e-9; }
+
+static void write_sections() {
+  for (const SectionStats &s : section_stats()) {
+    write_name(s.name);
+    schema::insert(db, schema::SectionStat{rank, s.name, int64_t(s.count),
+                                           seconds(s.total), seconds(s.min),
+                                           seconds(s.max)});
+  }
+}
+
+// where this rank's clock is against the other ranks', at point
+static void write_clock_sync(const char *point) {
+  const ClockSync sync = sync_clock(profileStartNs, clockWall);
+  clockWall = std::string(sync.source) == "wall";
+  schema::insert(db, schema::ClockOffset{rank, point, sync.source,
+                                         sync.localTime, sync.offset,
+                                         sync.error});
+}
+
+static void write_stats() {
+  for (const RegionPath &path : region_paths()) {
+    write_name(path.name);
+    schema::insert(db, schema::RegionPath{path.id, path.parent, path.name});
+  }
+  int64_t statID = 0;
+  for (const KernelStats &stats : merged_stats()) {
+    write_name(stats.name);
+    schema::insert(db, schema::KernelStat{
+                           statID, rank, stats.name, stats.kind,
+                           device_column(stats.devID), stats.path,
+                           int64_t(stats.count), seconds(stats.totalNs),
+                           seconds(stats.minNs), seconds(stats.maxNs)});
+    for (int b = 0; b < schema::Histogram::NUM_BUCKETS; ++b) {
+      if (stats.hist.counts[b]) {
+        schema::insert(db, schema::KernelHistogramBucket{
+                               statID,
+                               seconds(schema::Histogram::lower_bound(b)),
+                               seconds(schema::Histogram::upper_bound(b)),
+                               int64_t(stats.hist.counts[b])});
+      }
+    }
+    ++statID;
+  }
+  reset_stats();
+}
+
+static std::string sqlite_prefix() {
+  const char *prefix = std::getenv("KTS_SQLITE_PREFIX");
+  return prefix ? prefix : "kts_";
+}
+
+// This rank's statistics for each kernel, fence, region, deep copy and
+// section name, from the records, logged or not, and any aggregated statistics
+static std::vector<RankStat> rank_stats() {
+  std::string sql =
+      "SELECT k.KindID, n.Name, SUM(k.Count), SUM(k.Total), MIN(k.Min), "
+      "MAX(k.Max) FROM ("
+      "SELECT NameID, KindID, COUNT(*) AS Count, "
+      "SUM(Stop - Start) * 1e-9 AS Total, MIN(Stop - Start) * 1e-9 AS Min, "
+      "MAX(Stop - Start) * 1e-9 AS Max "
+      "FROM SpanRecords GROUP BY NameID, KindID "
+      "UNION ALL "
+      "SELECT NameID, KindID, SUM(Count), SUM(Total), MIN(Min), MAX(Max) "
+      "FROM KernelStats GROUP BY NameID, KindID ";
+  if (!sectionSpans) {
+    // otherwise the sections are in SpanRecords too
+    sql += "UNION ALL SELECT NameID, " + std::to_string(int(Kind::SECTION)) +
+           ", Count, Total, Min, Max FROM Sections ";
+  }
+  sql += ") k JOIN Names n ON n.ID = k.NameID GROUP BY k.NameID, k.KindID;";
+  sqlite3_stmt *stmt = schema::prepare_query(db, sql.c_str());
+  std::vector<RankStat> stats;
+  while (SQLITE_ROW == sqlite3_step(stmt)) {
+    stats.push_back(RankStat{Kind(sqlite3_column_int(stmt, 0)),
+                             schema::column_text(stmt, 1),
+                             uint64_t(sqlite3_column_int64(stmt, 2)),
+                             sqlite3_column_double(stmt, 3),
+                             sqlite3_column_double(stmt, 4),
+                             sqlite3_column_double(stmt, 5)});
+  }
+  sqlite3_finalize(stmt);
+
+  // spans that went to the log instead of SpanRecords
+  std::map<std::pair<Kind, std::string>, size_t> index;
+  for (size_t i = 0; i < stats.size(); ++i) {
+    index[{stats[i].kind, stats[i].name}] = i;
+  }
+  for (const auto &kv : loggedSpans) {
+    const Kind kind = Kind(kv.first & 0xff);
+    const std::string name = name_of(NameID(kv.first >> 8));
+    const LoggedSpans &l = kv.second;
+    auto it = index.find({kind, name});
+    if (it == index.end()) {
+      stats.push_back(RankStat{kind, name, l.count, seconds(l.total),
+                               seconds(l.min), seconds(l.max)});
+      continue;
+    }
+    RankStat &stat = stats[it->second];
+    stat.count += l.count;
+    stat.total += seconds(l.total);
+    stat.min = std::min(stat.min, seconds(l.min));
+    stat.max = std::max(stat.max, seconds(l.max));
+  }
+  return stats;
+}
+
+// Span and name IDs are only unique within a session, so a database left by an
+// earlier one is replaced rather than added to
+static void remove_database(const std::string &path) {
+  if (0 == std::remove(path.c_str())) {
+    std::cerr << "KTS: replaced existing " << path << "\n";
+  }
+  for (const char *suffix : {"-journal", "-wal", "-shm"}) {
+    std::remove((path + suffix).c_str());
+  }
+}
+
+// init may be called again after finalize, to profile another session into a
+// new database where KTS_SQLITE_PREFIX names by then. Calls out of turn are
+// ignored
 void init() {
+  if (db) {
+    return;
+  }
   std::cerr << "==== libkts.so: init ====\n";
   rank = kts_mpi_rank();
   std::cerr << __FILE__ << ":" << __LINE__ << " " << rank << "\n";
-  worker.start();
-  const char *sqlitePrefix = std::getenv("KTS_SQLITE_PREFIX");
-  if (!sqlitePrefix) {
-    sqlitePrefix = "kts_";
-  }
-
-  std::string sqlitePath =
-      std::string(sqlitePrefix) + std::to_string(rank) + ".sqlite";
+  std::string sqlitePath = sqlite_prefix() + std::to_string(rank) + ".sqlite";
+  remove_database(sqlitePath);
   {
     std::cerr << __FILE__ << ":" << __LINE__ << " open " << sqlitePath << "\n";
     int rc = sqlite3_open(sqlitePath.c_str(), &db);
@@ -172,152 +854,380 @@ void init() {
 
   begin_transaction();
 
-  // create Spans table
-  {
+  schema::create_tables(db);
 
-    char *errMsg = 0;
-    int rc = sqlite3_exec(db, schema::Span::create_table_sql, 0, 0, &errMsg);
-    if (rc != SQLITE_OK) {
-      std::cerr << "SQL error: " << errMsg << std::endl;
-      sqlite3_free(errMsg);
-    }
-  }
+  commit_transaction();
+
+  schema::init(db);
 
-  // create Events table
+  begin_transaction();
   {
-    char *errMsg = 0;
-    int rc = sqlite3_exec(db, schema::Event::create_table_sql, 0, 0, &errMsg);
-    if (rc != SQLITE_OK) {
-      std::cerr << "SQL error: " << errMsg << std::endl;
-      sqlite3_free(errMsg);
-    }
+    const std::string version = std::to_string(schema::VERSION);
+    schema::insert(db, schema::Meta{"schema_version", version.c_str()});
+  }
+  for (int k = 0; k < int(Kind::NUM_KINDS); ++k) {
+    schema::insert(db, schema::KindName{Kind(k)});
   }
 
-  commit_transaction();
+  init_filter();
+  write_filter_config();
 
-  schema::init(db);
+  const std::string output = env_str("KTS_OUTPUT", "sqlite");
+  if (output == "log") {
+    const std::string logPath =
+        sqlite_prefix() + std::to_string(rank) + ".ktslog";
+    std::cerr << "KTS: writing records to " << logPath << "\n";
+    traceLog = std::make_unique<schema::LogWriter>(logPath, rank);
+  } else if (output != "sqlite") {
+    std::cerr << "KTS: unknown KTS_OUTPUT=" << output << ", using \"sqlite\"\n";
+  }
+  schema::insert(db, schema::Meta{"output", traceLog ? "log" : "sqlite"});
+  summarizeLog = traceLog && env_bool("KTS_MPI_SUMMARY", false);
 
-  begin_transaction();
-  profileStart = Clock::now();
+  aggregateMode = std::string(env_str("KTS_MODE", "trace")) == "aggregate";
+  init_overflow();
+  if (aggregateMode) {
+    std::cerr << "KTS: aggregate mode, writing KernelStats at finalize\n";
+  }
+
+  const Timer timer = init_timer(env_str("KTS_TIMER", "steady"));
+  schema::insert(db, schema::Meta{"timer", timer_name(timer)});
+  init_overhead(env_u64("KTS_SELF_TIME_EVERY", 16));
+  init_memory(env_u64("KTS_MEMORY_POINTS", 4096));
+  init_sections();
+  sectionSpans = env_bool("KTS_SECTION_SPANS", false);
+  globalFences = env_bool("KTS_GLOBAL_FENCES", false);
+  schema::insert(db, schema::Meta{"global_fences", globalFences ? "1" : "0"});
+  profileStartNs = now_ns();
+  clockWall = std::string(env_str("KTS_CLOCK_SYNC", "mpi")) == "wall";
+  write_clock_sync("init");
+  writer.start(env_u64("KTS_COMMIT_RECORDS", 100000),
+               std::chrono::milliseconds(env_u64("KTS_COMMIT_MS", 1000)));
+
+  if (env_bool("KTS_FLUSH_ON_SIGNAL", true)) {
+    install_signal_handlers();
+  }
+  static bool registeredAtExit = false;
+  if (!registeredAtExit) {
+    std::atexit(finalize_at_exit);
+    registeredAtExit = true;
+  }
 }
 
+bool requires_global_fencing() { return globalFences; }
+
 void finalize() {
+  if (!db) {
+    return;
+  }
   std::cerr << "==== libkts.so: finalize ====\n";
 
-  worker.join();
+  uninstall_signal_handlers();
+  const std::string duration = std::to_string(seconds(now()));
+  writer.join();
+  schema::insert(db, schema::Meta{"duration", duration.c_str()});
+  write_clock_sync("finalize");
+  if (traceLog) {
+    schema::insert(db, schema::KtsStat{rank, "log_bytes",
+                                       double(traceLog->bytes())});
+    traceLog.reset();
+    namesLogged.clear();
+  }
+  const bool degraded = degradedRecords.load() > 0;
+  write_overflow_stats();
+  write_overhead_stats();
+  write_memory();
+  write_sections();
+  if (aggregateMode || degraded) {
+    write_stats();
+  }
+  write_sample_counts();
+  if (env_bool("KTS_INDEX", false)) {
+    std::cerr << "KTS: building indexes\n";
+    schema::create_indexes(db);
+  }
   commit_transaction();
+  const bool summarize = env_bool("KTS_MPI_SUMMARY", false);
+  const std::vector<RankStat> stats =
+      summarize ? rank_stats() : std::vector<RankStat>{};
+  loggedSpans.clear();
+  namesWritten.clear();
   schema::finalize(db);
   sqlite3_close(db);
   db = nullptr;
+  if (summarize &&
+      !write_rank_summary(stats, sqlite_prefix() + "summary.sqlite")) {
+    std::cerr << "KTS: KTS_MPI_SUMMARY needs KTS built with MPI, and MPI "
+                 "running at finalize\n";
+  }
 }
 
-static void record_span(const Span &span, Duration &&stop) {
-
-  worker.add_job([=] {
-    const char *name = span.name.c_str();
-    if (!name) {
-      name = "<null name>";
+static void overflow(const Record &record) {
+  switch (overflowPolicy) {
+  case Overflow::DROP: {
+    droppedRecords.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  case Overflow::AGGREGATE: {
+    degradedRecords.fetch_add(1, std::memory_order_relaxed);
+    const uint64_t ns = record.stop - record.start;
+    if (record.kind == Kind::DEEPCOPY) {
+      aggregate(copy_name(record.srcSpace, record.srcName, record.devID,
+                          record.name),
+                record.kind, NO_DEVICE, ROOT_PATH, ns);
+    } else {
+      aggregate(record.name, record.kind, record.devID, ROOT_PATH, ns);
+    }
+    return;
+  }
+  case Overflow::BLOCK: {
+    const TimePoint start = Clock::now();
+    while (!producer.queue->ring.try_push(record)) {
+      // after finalize nothing drains the queue, so there is no room coming
+      if (!writer.running()) {
+        droppedRecords.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+      std::this_thread::yield();
     }
-    schema::insert(db, schema::Span{span.rank, name, span.kind,
-                                    span.start.count(), stop.count()});
-  });
+    delayedRecords.fetch_add(1, std::memory_order_relaxed);
+    delayNs.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                          Clock::now() - start)
+                          .count(),
+                      std::memory_order_relaxed);
+    return;
+  }
+  }
+}
+
+static void push_record(const Record &record) {
+  if (!producer.queue) {
+    producer.queue = queues.acquire();
+  }
+  if (!producer.queue->ring.try_push(record)) {
+    overflow(record);
+  }
+}
+
+// the regions enclosing the calling thread's next span or event
+static PathID current_path() {
+  return producer.regions.empty() ? ROOT_PATH : producer.regions.back().inner;
+}
+
+// The innermost recorded region enclosing the calling thread's next span or
+// event, and how many recorded regions enclose it. Regions that are not
+// recorded are skipped, so every ParentID refers to a row
+struct Parent {
+  uint64_t id;
+  uint32_t depth;
+};
+static Parent current_parent() {
+  if (producer.regions.empty()) {
+    return Parent{NO_PARENT, 0};
+  }
+  const Span &region = producer.regions.back();
+  return region.recorded ? Parent{region.id, region.depth + 1}
+                         : Parent{region.parent, region.depth};
 }
 
-static void record_event(const Event &event, Duration &&time) {
+static void record_span(const Span &span, int64_t stop) {
+  if (aggregateMode) {
+    aggregate(span.name, span.kind, span.devID, span.path, stop - span.start);
+    return;
+  }
+  push_record(Record{Record::Type::SPAN, span.kind, uint16_t(span.depth),
+                     span.devID, span.name, span.tid, span.id, span.parent,
+                     span.start, stop, 0, 0, 0});
+}
+
+// in aggregate mode, events are only counted
+static void record_event(NameID name, Kind kind, int64_t time) {
+  if (!name_included(name)) {
+    return;
+  }
+  if (aggregateMode) {
+    aggregate(name, kind, NO_DEVICE, current_path(), 0);
+    return;
+  }
+  const Parent parent = current_parent();
+  push_record(Record{Record::Type::EVENT, kind, uint16_t(parent.depth),
+                     NO_DEVICE, name, producer.tid, 0, parent.id, time, time,
+                     0, 0, 0});
+}
 
-  worker.add_job([=] {
-    const char *name = event.name.c_str();
-    if (!name) {
-      name = "<null name>";
+// returned by begin_span for launches that are not recorded
+static constexpr uint64_t UNSAMPLED = std::numeric_limits<uint64_t>::max() - 1;
+
+static uint64_t begin_span(const char *name, Kind kind, uint32_t devID) {
+  const CallbackTimer timed(Callback::BEGIN_SPAN);
+  const NameID nameID = intern_name(name);
+  if (!sample_launch(nameID)) {
+    return UNSAMPLED;
+  }
+  uint64_t kID = producer.next_span_id();
+  const Parent parent = current_parent();
+  if (!spans.insert(kID, Span{nameID, kind, true, devID, producer.tid,
+                              parent.depth, current_path(), ROOT_PATH, kID,
+                              parent.id, now()})) {
+    static std::atomic<bool> warned{false};
+    if (!warned.exchange(true, std::memory_order_relaxed)) {
+      std::cerr << "KTS: too many open spans, some will not be recorded\n";
     }
+  }
+  return kID;
+}
 
-    schema::insert(db,
-                   schema::Event{event.rank, name, event.kind, time.count()});
-  });
+static void end_span(const uint64_t kID) {
+  const CallbackTimer timed(Callback::END_SPAN);
+  if (kID == UNSAMPLED) {
+    return;
+  }
+  const int64_t stop = now();
+  Span span;
+  if (spans.take(kID, span)) {
+    record_span(span, stop);
+  }
 }
 
 // returns a unique id
 uint64_t begin_parallel_for(const char *name, const uint32_t devID) {
-  uint64_t kID = spanID++;
-  spans[kID] = Span(
-      rank, name, std::string(KIND_PARFOR) + "[" + std::to_string(devID) + "]",
-      Clock::now() - profileStart);
-  return kID;
+  return begin_span(name, Kind::PARFOR, devID);
 }
 uint64_t begin_parallel_reduce(const char *name, const uint32_t devID) {
-  uint64_t kID = spanID++;
-  spans[kID] = Span(
-      rank, name, std::string(KIND_PARRED) + "[" + std::to_string(devID) + "]",
-      Clock::now() - profileStart);
-  return kID;
+  return begin_span(name, Kind::PARRED, devID);
 }
 uint64_t begin_parallel_scan(const char *name, const uint32_t devID) {
-  uint64_t kID = spanID++;
-  spans[kID] = Span(
-      rank, name, std::string(KIND_PARSCAN) + "[" + std::to_string(devID) + "]",
-      Clock::now() - profileStart);
-  return kID;
+  return begin_span(name, Kind::PARSCAN, devID);
 }
 
 // accepts the return value of the corresponding begin_parallel_for
-void end_parallel_region(const uint64_t kID) {
-  record_span(spans[kID], Clock::now() - profileStart);
-  spans.erase(kID);
-}
+void end_parallel_region(const uint64_t kID) { end_span(kID); }
 
+// regions nest per thread: a pop ends the latest region pushed by the same
+// thread
 void push_profile_region(const char *name) {
-  spanID++;
-  regions.emplace_back(rank, name, KIND_REGION, Clock::now() - profileStart);
+  const CallbackTimer timed(Callback::PUSH_REGION);
+  const uint64_t id = producer.next_span_id();
+  const NameID nameID = intern_name(name);
+  const PathID path = current_path();
+  const PathID inner = aggregateMode ? intern_path(path, nameID) : ROOT_PATH;
+  const Parent parent = current_parent();
+  producer.regions.push_back(Span{nameID, Kind::REGION,
+                                  name_included(nameID), NO_DEVICE,
+                                  producer.tid, parent.depth, path, inner, id,
+                                  parent.id, now()});
 }
 void pop_profile_region() {
+  const CallbackTimer timed(Callback::POP_REGION);
+  std::vector<Span> &regions = producer.regions;
   if (!regions.empty()) {
-    record_span(regions.back(), Clock::now() - profileStart);
+    if (regions.back().recorded) {
+      record_span(regions.back(), now());
+    }
     regions.pop_back();
   }
 }
 
+// Deep copies are spans like kernels, but carry their endpoints and size to
+// the writer thread. Their name is formatted on the calling thread, since the
+// include / exclude filters match on it, once per distinct copy
 void begin_deep_copy(const char *dstSpaceName, const char *dstName,
                      const void *dst_ptr, const char *srcSpaceName,
                      const char *srcName, const void *src_ptr, uint64_t size) {
-
+  const CallbackTimer timed(Callback::BEGIN_SPAN);
   (void)dst_ptr;
-  (void)srcName;
   (void)src_ptr;
-
-  std::stringstream ss;
-  ss << srcName << "[" << srcSpaceName << "]"
-     << "->" << dstName << "[" << dstSpaceName << "]"
-     << "(" << size << ")";
-  record_event(Event(rank, ss.str(), KIND_DEEPCOPY),
-               Clock::now() - profileStart);
+  const NameID dstSpace = intern_name(dstSpaceName);
+  const NameID dst = intern_name(dstName);
+  const NameID srcSpace = intern_name(srcSpaceName);
+  const NameID src = intern_name(srcName);
+  const NameID copy = copy_name(srcSpace, src, dstSpace, dst);
+  const Parent parent = current_parent();
+  producer.copies.push_back(
+      OpenCopy{Span{dst, Kind::DEEPCOPY, name_included(copy), dstSpace,
+                    producer.tid, parent.depth, current_path(), ROOT_PATH,
+                    producer.next_span_id(), parent.id, now()},
+               srcSpace, src, copy, size});
+}
+void end_deep_copy() {
+  const CallbackTimer timed(Callback::END_SPAN);
+  std::vector<OpenCopy> &copies = producer.copies;
+  if (copies.empty()) {
+    return;
+  }
+  const int64_t stop = now();
+  const OpenCopy &c = copies.back();
+  if (c.span.recorded) {
+    if (aggregateMode) {
+      aggregate(c.copy, Kind::DEEPCOPY, NO_DEVICE, c.span.path,
+                stop - c.span.start);
+    } else {
+      push_record(Record{Record::Type::SPAN, Kind::DEEPCOPY,
+                         uint16_t(c.span.depth), c.span.devID, c.span.name,
+                         c.span.tid, c.span.id, c.span.parent, c.span.start,
+                         stop, c.srcSpace, c.srcName, c.bytes});
+    }
+  }
+  copies.pop_back();
 }
 
 // returns a unique id
 uint64_t begin_fence(const char *name, const uint32_t devID) {
-  uint64_t kID = spanID++;
-  spans[kID] = Span(rank, name,
-                    std::string(KIND_FENCE) + "[" + std::to_string(devID) + "]",
-                    Clock::now() - profileStart);
-  return kID;
+  return begin_span(name, Kind::FENCE, devID);
 }
 
 // accepts the return value of the corresponding begin_fence
-void end_fence(const uint64_t kID) {
-  record_span(spans[kID], Clock::now() - profileStart);
-  spans.erase(kID);
-}
+void end_fence(const uint64_t kID) { end_span(kID); }
 
+// allocations are tracked whether or not their events pass the filters
 void allocate_data(const char *spaceName, const char *name, void *ptr,
                    size_t size) {
-  record_event(Event(rank, name, KIND_ALLOC), Clock::now() - profileStart);
+  const CallbackTimer timed(Callback::EVENT);
+  const NameID nameID = intern_name(name);
+  const int64_t time = now();
+  track_alloc(intern_name(spaceName), nameID, ptr, size, time);
+  record_event(nameID, Kind::ALLOC, time);
 }
 void deallocate_data(const char *spaceName, const char *name, void *ptr,
                      size_t size) {
-  record_event(Event(rank, name, KIND_DEALLOC), Clock::now() - profileStart);
+  const CallbackTimer timed(Callback::EVENT);
+  (void)spaceName;
+  (void)size;
+  const int64_t time = now();
+  track_free(ptr, time);
+  record_event(intern_name(name), Kind::DEALLOC, time);
 }
 
 void profile_event(const char *name) {
-  record_event(Event(rank, name, KIND_EVENT), Clock::now() - profileStart);
+  const CallbackTimer timed(Callback::EVENT);
+  record_event(intern_name(name), Kind::EVENT, now());
+}
+
+// Each section has an ID of its own, so nested sections of the same name are
+// timed separately, and accumulate under their name
+uint32_t create_profile_section(const char *name) {
+  return create_section(intern_name(name));
+}
+void start_profile_section(const uint32_t secID) {
+  const CallbackTimer timed(Callback::SECTION);
+  start_section(secID, now());
+}
+void stop_profile_section(const uint32_t secID) {
+  const CallbackTimer timed(Callback::SECTION);
+  const int64_t stop = now();
+  const int64_t start = stop_section(secID, stop);
+  if (sectionSpans && start >= 0) {
+    const NameID name = section_name(secID);
+    if (!name_included(name)) {
+      return;
+    }
+    const Parent parent = current_parent();
+    record_span(Span{name, Kind::SECTION, true, NO_DEVICE, producer.tid,
+                     parent.depth, current_path(), ROOT_PATH,
+                     producer.next_span_id(), parent.id, start},
+                stop);
+  }
 }
+void destroy_profile_section(const uint32_t secID) { destroy_section(secID); }
 
-} // namespace lib
\ No newline at end of file
+} // namespace lib
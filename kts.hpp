@@ -8,6 +8,10 @@ void init();
 
 void finalize();
 
+// KTS_GLOBAL_FENCES: whether Kokkos should fence after every kernel so that
+// spans cover device execution
+bool requires_global_fencing();
+
 // returns a unique id
 uint64_t begin_parallel_for(const char *name, const uint32_t devID);
 uint64_t begin_parallel_reduce(const char *name, const uint32_t devID);
@@ -22,6 +26,8 @@ void pop_profile_region();
 void begin_deep_copy(const char *dstSpaceName, const char *dstName,
                      const void *dst_ptr, const char *srcSpaceName,
                      const char *srcName, const void *src_ptr, uint64_t size);
+// ends the latest deep copy begun by the calling thread
+void end_deep_copy();
 
 // returns a unique id
 uint64_t begin_fence(const char *name, const uint32_t devID);
@@ -36,4 +42,10 @@ void deallocate_data(const char *spaceName, const char *name, void *ptr,
 
 void profile_event(const char *name);
 
+// returns a new section id, reused once the section is destroyed
+uint32_t create_profile_section(const char *name);
+void start_profile_section(const uint32_t secID);
+void stop_profile_section(const uint32_t secID);
+void destroy_profile_section(const uint32_t secID);
+
 } // namespace lib
\ No newline at end of file
@@ -0,0 +1,196 @@
+#include "kts_aggregate.hpp"
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace lib {
+
+static uint64_t path_key(PathID parent, NameID name) {
+  return (uint64_t(parent) << 32) | name;
+}
+
+static std::mutex pathsMutex;
+static std::vector<RegionPath> paths{{ROOT_PATH, ROOT_PATH, 0}};
+static std::unordered_map<uint64_t, PathID> pathIDs;
+
+// each thread remembers the paths it has already looked up
+static thread_local std::unordered_map<uint64_t, PathID> pathCache;
+
+PathID intern_path(PathID parent, NameID name) {
+  const uint64_t key = path_key(parent, name);
+  auto it = pathCache.find(key);
+  if (it != pathCache.end()) {
+    return it->second;
+  }
+  PathID id;
+  {
+    std::lock_guard<std::mutex> lock(pathsMutex);
+    auto jt = pathIDs.find(key);
+    if (jt != pathIDs.end()) {
+      id = jt->second;
+    } else {
+      id = PathID(paths.size());
+      paths.push_back(RegionPath{id, parent, name});
+      pathIDs.emplace(key, id);
+    }
+  }
+  pathCache.emplace(key, id);
+  return id;
+}
+
+std::vector<RegionPath> region_paths() {
+  std::lock_guard<std::mutex> lock(pathsMutex);
+  // skip the root
+  return std::vector<RegionPath>(paths.begin() + 1, paths.end());
+}
+
+namespace {
+
+// Open addressing on a flat array. The hot fields of an entry share a cache
+// line; histograms are kept in a separate array and only touched to bump one
+// counter.
+class StatsTable {
+public:
+  StatsTable() { rehash(64); }
+
+  void add(NameID name, schema::Kind kind, uint32_t devID, PathID path,
+           uint64_t ns) {
+    const uint64_t k0 = (uint64_t(name) << 32) | path;
+    const uint64_t k1 = (uint64_t(kind) << 32) | devID;
+    size_t i = hash(k0, k1) & mask_;
+    while (true) {
+      Entry &e = entries_[i];
+      if (e.count == 0) {
+        if (2 * (size_ + 1) > entries_.size()) {
+          rehash(2 * entries_.size());
+          add(name, kind, devID, path, ns);
+          return;
+        }
+        e = Entry{k0, k1, 1, ns, ns, ns, size_++};
+        hists_.emplace_back();
+        hists_[e.hist].add(ns);
+        return;
+      }
+      if (e.k0 == k0 && e.k1 == k1) {
+        ++e.count;
+        e.totalNs += ns;
+        e.minNs = ns < e.minNs ? ns : e.minNs;
+        e.maxNs = ns > e.maxNs ? ns : e.maxNs;
+        hists_[e.hist].add(ns);
+        return;
+      }
+      i = (i + 1) & mask_;
+    }
+  }
+
+  void clear() {
+    entries_.assign(entries_.size(), Entry{0, 0, 0, 0, 0, 0, 0});
+    hists_.clear();
+    size_ = 0;
+  }
+
+  template <typename F> void for_each(F &&f) const {
+    for (const Entry &e : entries_) {
+      if (e.count) {
+        f(KernelStats{NameID(e.k0 >> 32), schema::Kind(e.k1 >> 32),
+                      uint32_t(e.k1), PathID(e.k0), e.count, e.totalNs, e.minNs,
+                      e.maxNs, hists_[e.hist]});
+      }
+    }
+  }
+
+private:
+  struct Entry {
+    uint64_t k0; // name, path
+    uint64_t k1; // kind, device
+    uint64_t count;
+    uint64_t totalNs;
+    uint64_t minNs;
+    uint64_t maxNs;
+    size_t hist;
+  };
+
+  static size_t hash(uint64_t k0, uint64_t k1) {
+    uint64_t h = k0 * 0x9E3779B97F4A7C15ull ^ k1 * 0xC2B2AE3D27D4EB4Full;
+    return size_t(h ^ (h >> 29));
+  }
+
+  void rehash(size_t capacity) {
+    std::vector<Entry> old(capacity, Entry{0, 0, 0, 0, 0, 0, 0});
+    old.swap(entries_);
+    mask_ = capacity - 1;
+    for (const Entry &e : old) {
+      if (e.count) {
+        size_t i = hash(e.k0, e.k1) & mask_;
+        while (entries_[i].count) {
+          i = (i + 1) & mask_;
+        }
+        entries_[i] = e;
+      }
+    }
+  }
+
+  std::vector<Entry> entries_;
+  std::vector<schema::Histogram> hists_;
+  size_t mask_ = 0;
+  size_t size_ = 0;
+};
+
+} // namespace
+
+// Every thread's table, kept after the thread exits so finalize can read it
+static std::mutex tablesMutex;
+static std::vector<std::unique_ptr<StatsTable>> tables;
+
+static StatsTable *new_table() {
+  std::lock_guard<std::mutex> lock(tablesMutex);
+  tables.push_back(std::make_unique<StatsTable>());
+  return tables.back().get();
+}
+
+static thread_local StatsTable *table = nullptr;
+
+void aggregate(NameID name, schema::Kind kind, uint32_t devID, PathID path,
+               uint64_t ns) {
+  if (!table) {
+    table = new_table();
+  }
+  table->add(name, kind, devID, path, ns);
+}
+
+std::vector<KernelStats> merged_stats() {
+  std::vector<KernelStats> result;
+  std::map<std::pair<uint64_t, uint64_t>, size_t> index;
+  std::lock_guard<std::mutex> lock(tablesMutex);
+  for (const auto &t : tables) {
+    t->for_each([&](const KernelStats &s) {
+      const auto key = std::make_pair((uint64_t(s.name) << 32) | s.path,
+                                      (uint64_t(s.kind) << 32) | s.devID);
+      auto it = index.find(key);
+      if (it == index.end()) {
+        index.emplace(key, result.size());
+        result.push_back(s);
+      } else {
+        KernelStats &r = result[it->second];
+        r.count += s.count;
+        r.totalNs += s.totalNs;
+        r.minNs = std::min(r.minNs, s.minNs);
+        r.maxNs = std::max(r.maxNs, s.maxNs);
+        r.hist.merge(s.hist);
+      }
+    });
+  }
+  return result;
+}
+
+void reset_stats() {
+  std::lock_guard<std::mutex> lock(tablesMutex);
+  for (const auto &t : tables) {
+    t->clear();
+  }
+}
+
+} // namespace lib
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "kts_histogram.hpp"
+#include "kts_names.hpp"
+#include "kts_schema.hpp"
+
+namespace lib {
+
+// identifies a stack of region names. ROOT_PATH is outside of any region
+using PathID = uint32_t;
+constexpr PathID ROOT_PATH = 0;
+
+// the path of region name nested directly inside parent
+PathID intern_path(PathID parent, NameID name);
+
+struct RegionPath {
+  PathID id;
+  PathID parent;
+  NameID name;
+};
+
+// every path interned so far, parents before children
+std::vector<RegionPath> region_paths();
+
+// running statistics for one (name, kind, device, region path)
+struct KernelStats {
+  NameID name;
+  schema::Kind kind;
+  uint32_t devID;
+  PathID path;
+  uint64_t count;
+  uint64_t totalNs;
+  uint64_t minNs;
+  uint64_t maxNs;
+  schema::Histogram hist;
+};
+
+// add one occurrence to the calling thread's statistics
+void aggregate(NameID name, schema::Kind kind, uint32_t devID, PathID path,
+               uint64_t ns);
+
+// statistics from all threads, merged. Not safe to call while other threads
+// are still aggregating
+std::vector<KernelStats> merged_stats();
+
+// forget all statistics
+void reset_stats();
+
+} // namespace lib
@@ -0,0 +1,88 @@
+#include "kts_clock.hpp"
+
+#include <chrono>
+#include <limits>
+
+#if defined(KTS_ENABLE_MPI)
+#include <mpi.h>
+#endif
+
+#include "kts_timer.hpp"
+
+namespace lib {
+
+static ClockSync wall_clock(uint64_t startNs) {
+  const uint64_t before = now_ns();
+  const int64_t wallNs =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::system_clock::now().time_since_epoch())
+          .count();
+  const uint64_t after = now_ns();
+  const int64_t localTime = int64_t(before + (after - before) / 2 - startNs);
+  return ClockSync{"wall", localTime, wallNs - localTime, 0};
+}
+
+#if defined(KTS_ENABLE_MPI)
+
+// round trips to rank 0 per rank. The one that took the least time has the
+// least room for error, and is kept
+static constexpr int ROUNDS = 8;
+
+static ClockSync mpi_clock(uint64_t startNs) {
+  auto local = [startNs]() { return int64_t(now_ns() - startNs); };
+
+  // keep these messages apart from the application's
+  MPI_Comm comm;
+  MPI_Comm_dup(MPI_COMM_WORLD, &comm);
+  int rank, size;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &size);
+
+  ClockSync sync{"mpi", 0, 0, 0};
+  if (0 == rank) {
+    for (int peer = 1; peer < size; ++peer) {
+      for (int i = 0; i < ROUNDS; ++i) {
+        MPI_Recv(nullptr, 0, MPI_BYTE, peer, 0, comm, MPI_STATUS_IGNORE);
+        const int64_t t = local();
+        MPI_Send(&t, 1, MPI_INT64_T, peer, 0, comm);
+      }
+    }
+    sync.localTime = local();
+  } else {
+    int64_t best = std::numeric_limits<int64_t>::max();
+    for (int i = 0; i < ROUNDS; ++i) {
+      const int64_t t0 = local();
+      MPI_Send(nullptr, 0, MPI_BYTE, 0, 0, comm);
+      int64_t ref;
+      MPI_Recv(&ref, 1, MPI_INT64_T, 0, 0, comm, MPI_STATUS_IGNORE);
+      const int64_t t1 = local();
+      if (t1 - t0 < best) {
+        // rank 0 read its clock somewhere in the round trip; assume halfway
+        best = t1 - t0;
+        sync.localTime = t0 + best / 2;
+        sync.offset = ref - sync.localTime;
+        sync.error = (best + 1) / 2;
+      }
+    }
+  }
+  MPI_Comm_free(&comm);
+  return sync;
+}
+
+#endif
+
+ClockSync sync_clock(uint64_t startNs, bool wall) {
+#if defined(KTS_ENABLE_MPI)
+  int initialized, finalized;
+  MPI_Initialized(&initialized);
+  MPI_Finalized(&finalized);
+  if (!wall && initialized && !finalized) {
+    return mpi_clock(startNs);
+  }
+#else
+  (void)wall;
+#endif
+  return wall_clock(startNs);
+}
+
+} // namespace lib
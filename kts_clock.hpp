@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+
+namespace lib {
+
+// this rank's clock against a timeline shared by all ranks: a time t on this
+// rank, in ns since init, near localTime is t + offset on the shared timeline
+struct ClockSync {
+  const char *source; // "mpi" or "wall"
+  int64_t localTime;
+  int64_t offset;
+  int64_t error; // bound on the error of offset, 0 if not known
+};
+
+// Measure this rank's clock, whose times are now_ns() - startNs. With MPI
+// (built with it, running, and wall false) each rank times round trips to
+// rank 0 and the shared timeline is rank 0's: collective over MPI_COMM_WORLD,
+// and rank 0 serves the other ranks one at a time. Otherwise the shared
+// timeline is the system clock, in ns since the Unix epoch, and the error is
+// however well the hosts' clocks are synchronized
+ClockSync sync_clock(uint64_t startNs, bool wall);
+
+} // namespace lib
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+namespace lib {
+
+// the value of environment variable name, or def if it is unset or empty
+inline const char *env_str(const char *name, const char *def) {
+  const char *val = std::getenv(name);
+  if (!val || !*val) {
+    return def;
+  }
+  return val;
+}
+
+inline uint64_t env_u64(const char *name, uint64_t def) {
+  const char *val = env_str(name, nullptr);
+  if (!val) {
+    return def;
+  }
+  char *end = nullptr;
+  const unsigned long long v = std::strtoull(val, &end, 10);
+  if (*end) {
+    std::cerr << "KTS: ignoring " << name << "=" << val
+              << " (expected a non-negative integer)\n";
+    return def;
+  }
+  return v;
+}
+
+// false for "0", "off", "false", "no"; true for anything else that is set
+inline bool env_bool(const char *name, bool def) {
+  const char *val = env_str(name, nullptr);
+  if (!val) {
+    return def;
+  }
+  const std::string s(val);
+  return !(s == "0" || s == "off" || s == "OFF" || s == "false" ||
+           s == "FALSE" || s == "no" || s == "NO");
+}
+
+} // namespace lib
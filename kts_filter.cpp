@@ -0,0 +1,165 @@
+#include "kts_filter.hpp"
+
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <regex>
+
+#include "kts_env.hpp"
+
+namespace lib {
+
+static FilterConfig config{1, 0, "", ""};
+static std::unique_ptr<std::regex> includeRe;
+static std::unique_ptr<std::regex> excludeRe;
+// false when every launch of every name is recorded, so the callbacks can
+// skip the per-name state entirely
+static bool active = false;
+
+enum Decision : uint8_t { UNDECIDED, INCLUDED, EXCLUDED };
+
+struct NameState {
+  std::atomic<uint8_t> decision{UNDECIDED};
+  std::atomic<uint64_t> seen{0};
+  std::atomic<uint64_t> recorded{0};
+};
+
+// Per-name state indexed by NameID, in fixed-size chunks so that entries never
+// move and lookups need no lock
+static constexpr size_t CHUNK_BITS = 12;
+static constexpr size_t CHUNK_SIZE = size_t(1) << CHUNK_BITS;
+static constexpr size_t MAX_CHUNKS = 1024;
+static std::atomic<NameState *> chunks[MAX_CHUNKS];
+static std::mutex chunksMutex;
+
+static NameState *state(NameID name) {
+  const size_t c = name >> CHUNK_BITS;
+  if (c >= MAX_CHUNKS) {
+    return nullptr;
+  }
+  NameState *chunk = chunks[c].load(std::memory_order_acquire);
+  if (!chunk) {
+    std::lock_guard<std::mutex> lock(chunksMutex);
+    chunk = chunks[c].load(std::memory_order_relaxed);
+    if (!chunk) {
+      chunk = new NameState[CHUNK_SIZE];
+      chunks[c].store(chunk, std::memory_order_release);
+    }
+  }
+  return &chunk[name & (CHUNK_SIZE - 1)];
+}
+
+static std::unique_ptr<std::regex> compile(const char *var,
+                                           const std::string &pattern) {
+  if (pattern.empty()) {
+    return nullptr;
+  }
+  try {
+    return std::make_unique<std::regex>(
+        pattern, std::regex::ECMAScript | std::regex::optimize);
+  } catch (const std::regex_error &e) {
+    std::cerr << "KTS: ignoring " << var << "=" << pattern << ": " << e.what()
+              << "\n";
+    return nullptr;
+  }
+}
+
+void init_filter() {
+  config.sampleEvery = env_u64("KTS_SAMPLE_EVERY", 1);
+  if (0 == config.sampleEvery) {
+    config.sampleEvery = 1;
+  }
+  config.sampleFirst = env_u64("KTS_SAMPLE_FIRST", 0);
+  config.include = env_str("KTS_INCLUDE", "");
+  config.exclude = env_str("KTS_EXCLUDE", "");
+  includeRe = compile("KTS_INCLUDE", config.include);
+  excludeRe = compile("KTS_EXCLUDE", config.exclude);
+  active = includeRe || excludeRe || config.sampleEvery > 1;
+}
+
+const FilterConfig &filter_config() { return config; }
+
+static bool decide(NameID name) {
+  const char *s = name_of(name);
+  if (includeRe && !std::regex_search(s, *includeRe)) {
+    return false;
+  }
+  if (excludeRe && std::regex_search(s, *excludeRe)) {
+    return false;
+  }
+  return true;
+}
+
+static bool included(NameState &st, NameID name) {
+  uint8_t d = st.decision.load(std::memory_order_relaxed);
+  if (d == UNDECIDED) {
+    // racing threads reach the same answer
+    d = decide(name) ? INCLUDED : EXCLUDED;
+    st.decision.store(d, std::memory_order_relaxed);
+  }
+  return d == INCLUDED;
+}
+
+bool name_included(NameID name) {
+  if (!active) {
+    return true;
+  }
+  NameState *st = state(name);
+  return !st || included(*st, name);
+}
+
+bool sample_launch(NameID name) {
+  if (!active) {
+    return true;
+  }
+  NameState *st = state(name);
+  if (!st) {
+    return true;
+  }
+  const uint64_t n = st->seen.fetch_add(1, std::memory_order_relaxed);
+  if (!included(*st, name)) {
+    return false;
+  }
+  if (n < config.sampleFirst ||
+      0 == (n - config.sampleFirst) % config.sampleEvery) {
+    st->recorded.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+  return false;
+}
+
+std::vector<SampleCount> sample_counts() {
+  std::vector<SampleCount> result;
+  for (size_t c = 0; c < MAX_CHUNKS; ++c) {
+    NameState *chunk = chunks[c].load(std::memory_order_acquire);
+    if (!chunk) {
+      continue;
+    }
+    for (size_t i = 0; i < CHUNK_SIZE; ++i) {
+      const uint64_t seen = chunk[i].seen.load(std::memory_order_relaxed);
+      if (seen) {
+        result.push_back(
+            SampleCount{NameID((c << CHUNK_BITS) | i), seen,
+                        chunk[i].recorded.load(std::memory_order_relaxed)});
+      }
+    }
+  }
+  return result;
+}
+
+void reset_filter() {
+  for (size_t c = 0; c < MAX_CHUNKS; ++c) {
+    NameState *chunk = chunks[c].load(std::memory_order_acquire);
+    if (!chunk) {
+      continue;
+    }
+    for (size_t i = 0; i < CHUNK_SIZE; ++i) {
+      chunk[i].decision.store(UNDECIDED, std::memory_order_relaxed);
+      chunk[i].seen.store(0, std::memory_order_relaxed);
+      chunk[i].recorded.store(0, std::memory_order_relaxed);
+    }
+  }
+}
+
+} // namespace lib
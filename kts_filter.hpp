@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "kts_names.hpp"
+
+namespace lib {
+
+struct FilterConfig {
+  uint64_t sampleEvery; // record one in every sampleEvery launches
+  uint64_t sampleFirst; // record the first sampleFirst launches regardless
+  std::string include;  // if set, only names matching this regex
+  std::string exclude;  // if set, no names matching this regex
+};
+
+// read KTS_SAMPLE_EVERY, KTS_SAMPLE_FIRST, KTS_INCLUDE and KTS_EXCLUDE and
+// compile the patterns
+void init_filter();
+
+const FilterConfig &filter_config();
+
+// whether records named name pass KTS_INCLUDE / KTS_EXCLUDE.
+// Decided once per name
+bool name_included(NameID name);
+
+// count one launch of the kernel name and decide whether to record it
+bool sample_launch(NameID name);
+
+struct SampleCount {
+  NameID name;
+  uint64_t seen;
+  uint64_t recorded;
+};
+
+// launch counts for every kernel that went through sample_launch
+std::vector<SampleCount> sample_counts();
+
+// forget the counts and cached decisions
+void reset_filter();
+
+} // namespace lib
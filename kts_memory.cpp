@@ -0,0 +1,296 @@
+#include "kts_memory.hpp"
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <utility>
+
+namespace lib {
+
+namespace {
+
+struct Allocation {
+  uint64_t address; // 0 for an empty slot
+  uint64_t size;
+  uint64_t seq; // order of allocation
+  int64_t time;
+  NameID space;
+  NameID name;
+};
+
+// Live allocations by address: open addressing with linear probing, kept at
+// most half full. Removal shifts later entries of the probe run back instead
+// of leaving tombstones, so lookups never slow down as allocations churn
+class AllocationTable {
+public:
+  AllocationTable() { rehash(1024); }
+
+  // replaces any allocation already at a.address
+  void insert(const Allocation &a) {
+    if (2 * (size_ + 1) > slots_.size()) {
+      rehash(2 * slots_.size());
+    }
+    size_t i = hash(a.address) & mask_;
+    while (slots_[i].address && slots_[i].address != a.address) {
+      i = (i + 1) & mask_;
+    }
+    if (!slots_[i].address) {
+      ++size_;
+    }
+    slots_[i] = a;
+  }
+
+  // removes the allocation at address into a. Returns false if there is none
+  bool take(uint64_t address, Allocation &a) {
+    size_t i = hash(address) & mask_;
+    while (slots_[i].address != address) {
+      if (!slots_[i].address) {
+        return false;
+      }
+      i = (i + 1) & mask_;
+    }
+    a = slots_[i];
+    // shift back any entry that would become unreachable through the hole
+    size_t hole = i;
+    for (size_t j = (i + 1) & mask_; slots_[j].address; j = (j + 1) & mask_) {
+      const size_t home = hash(slots_[j].address) & mask_;
+      if (((j - home) & mask_) >= ((j - hole) & mask_)) {
+        slots_[hole] = slots_[j];
+        hole = j;
+      }
+    }
+    slots_[hole].address = 0;
+    --size_;
+    return true;
+  }
+
+  template <typename F> void for_each(F &&f) const {
+    for (const Allocation &a : slots_) {
+      if (a.address) {
+        f(a);
+      }
+    }
+  }
+
+  void clear() {
+    slots_.assign(slots_.size(), Allocation{});
+    size_ = 0;
+  }
+
+private:
+  static size_t hash(uint64_t address) {
+    // allocations are aligned, so the low bits carry little
+    const uint64_t h = address * 0x9E3779B97F4A7C15ull;
+    return size_t(h ^ (h >> 32));
+  }
+
+  void rehash(size_t capacity) {
+    std::vector<Allocation> old(capacity, Allocation{});
+    old.swap(slots_);
+    mask_ = capacity - 1;
+    size_ = 0;
+    for (const Allocation &a : old) {
+      if (a.address) {
+        insert(a);
+      }
+    }
+  }
+
+  std::vector<Allocation> slots_;
+  size_t mask_ = 0;
+  size_t size_ = 0;
+};
+
+// Usage over time, at most maxPoints points. Each point starts at the first
+// change at least interval after the previous point started; when the points
+// run out, neighbours are merged and the interval doubles
+class Timeline {
+public:
+  void add(int64_t time, uint64_t bytes, size_t maxPoints) {
+    if (!points_.empty() && time - points_.back().time < interval_) {
+      Point &p = points_.back();
+      p.bytes = bytes;
+      p.maxBytes = bytes > p.maxBytes ? bytes : p.maxBytes;
+      return;
+    }
+    if (points_.size() >= maxPoints) {
+      for (size_t i = 0; i + 1 < points_.size(); i += 2) {
+        Point &p = points_[i];
+        const Point &q = points_[i + 1];
+        p.bytes = q.bytes;
+        p.maxBytes = q.maxBytes > p.maxBytes ? q.maxBytes : p.maxBytes;
+        points_[i / 2] = p;
+      }
+      if (points_.size() % 2) {
+        points_[points_.size() / 2] = points_.back();
+      }
+      points_.resize((points_.size() + 1) / 2);
+      interval_ *= 2;
+    }
+    points_.push_back(Point{time, bytes, bytes});
+  }
+
+  template <typename F> void for_each(F &&f) const {
+    for (const Point &p : points_) {
+      f(p.time, p.bytes, p.maxBytes);
+    }
+  }
+
+private:
+  struct Point {
+    int64_t time;
+    uint64_t bytes;
+    uint64_t maxBytes;
+  };
+  std::vector<Point> points_;
+  int64_t interval_ = 1000; // ns
+};
+
+struct PeakUse {
+  NameID name;
+  uint64_t size;
+};
+
+struct Space {
+  NameID name;
+  uint64_t bytes = 0;
+  uint64_t peakBytes = 0;
+  int64_t peakTime = 0;
+  uint64_t peakSeq = 0; // the allocation that reached the peak
+  uint64_t allocations = 0;
+  uint64_t deallocations = 0;
+  Timeline timeline;
+  // Allocations alive at the peak that have been freed since. With the live
+  // allocations up to peakSeq, that is everything alive at the peak. Cleared
+  // whenever the peak moves, since nothing freed before a peak is alive at it
+  std::vector<PeakUse> freedSincePeak;
+};
+
+} // namespace
+
+// allocations can be freed by a different thread than made them, so all of
+// this is shared
+static std::mutex memoryMutex;
+static AllocationTable live;
+static std::vector<Space> spaces; // few enough to search
+static uint64_t nextSeq = 1;
+static uint64_t unmatchedFrees = 0;
+static size_t maxPoints = 4096;
+
+static Space &space_of(NameID name) {
+  for (Space &s : spaces) {
+    if (s.name == name) {
+      return s;
+    }
+  }
+  spaces.emplace_back();
+  spaces.back().name = name;
+  return spaces.back();
+}
+
+// take a out of the bytes in use in its space
+static Space &release(const Allocation &a) {
+  Space &s = space_of(a.space);
+  s.bytes -= a.size;
+  if (a.seq <= s.peakSeq) {
+    s.freedSincePeak.push_back(PeakUse{a.name, a.size});
+  }
+  return s;
+}
+
+void init_memory(size_t timelinePoints) {
+  std::lock_guard<std::mutex> lock(memoryMutex);
+  live.clear();
+  spaces.clear();
+  nextSeq = 1;
+  unmatchedFrees = 0;
+  maxPoints = std::max(timelinePoints, size_t(2));
+}
+
+void track_alloc(NameID space, NameID name, const void *ptr, uint64_t size,
+                 int64_t time) {
+  const uint64_t address = reinterpret_cast<uintptr_t>(ptr);
+  if (!address) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(memoryMutex);
+  const Allocation a{address, size, nextSeq++, time, space, name};
+  Allocation missed;
+  if (live.take(address, missed)) {
+    // the free of the allocation that was here never arrived
+    release(missed);
+  }
+  live.insert(a);
+
+  Space &s = space_of(space);
+  s.bytes += size;
+  ++s.allocations;
+  if (s.bytes > s.peakBytes) {
+    s.peakBytes = s.bytes;
+    s.peakTime = time;
+    s.peakSeq = a.seq;
+    s.freedSincePeak.clear();
+  }
+  s.timeline.add(time, s.bytes, maxPoints);
+}
+
+void track_free(const void *ptr, int64_t time) {
+  const uint64_t address = reinterpret_cast<uintptr_t>(ptr);
+  if (!address) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(memoryMutex);
+  Allocation a;
+  if (!live.take(address, a)) {
+    ++unmatchedFrees;
+    return;
+  }
+  Space &s = release(a);
+  ++s.deallocations;
+  s.timeline.add(time, s.bytes, maxPoints);
+}
+
+MemoryReport memory_report(int64_t time) {
+  std::lock_guard<std::mutex> lock(memoryMutex);
+  MemoryReport report;
+  report.unmatchedFrees = unmatchedFrees;
+
+  std::map<std::pair<NameID, NameID>, MemoryPeakUse> peaks;
+  auto at_peak = [&](NameID space, NameID name, uint64_t size) {
+    MemoryPeakUse &p = peaks[std::make_pair(space, name)];
+    p.space = space;
+    p.name = name;
+    p.count += 1;
+    p.bytes += size;
+  };
+
+  for (Space &s : spaces) {
+    report.spaces.push_back(MemorySpaceStats{s.name, s.peakBytes, s.peakTime,
+                                             s.bytes, s.allocations,
+                                             s.deallocations});
+    s.timeline.for_each([&](int64_t t, uint64_t bytes, uint64_t maxBytes) {
+      report.timeline.push_back(MemorySample{s.name, t, bytes, maxBytes});
+    });
+    report.timeline.push_back(MemorySample{s.name, time, s.bytes, s.bytes});
+    for (const PeakUse &p : s.freedSincePeak) {
+      at_peak(s.name, p.name, p.size);
+    }
+  }
+  live.for_each([&](const Allocation &a) {
+    if (a.seq <= space_of(a.space).peakSeq) {
+      at_peak(a.space, a.name, a.size);
+    }
+    report.leaks.push_back(
+        LiveAllocation{a.space, a.name, a.address, a.size, a.time});
+  });
+  std::sort(report.leaks.begin(), report.leaks.end(),
+            [](const LiveAllocation &a, const LiveAllocation &b) {
+              return a.time < b.time;
+            });
+  for (const auto &kv : peaks) {
+    report.peaks.push_back(kv.second);
+  }
+  return report;
+}
+
+} // namespace lib
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "kts_names.hpp"
+
+namespace lib {
+
+// Tracks live allocations from allocate_data / deallocate_data, per memory
+// space: current and peak bytes, a usage timeline of at most timelinePoints
+// points per space, the allocations alive at each space's peak, and the
+// allocations never freed. Forgets anything tracked before
+void init_memory(size_t timelinePoints);
+
+// time is ns since init
+void track_alloc(NameID space, NameID name, const void *ptr, uint64_t size,
+                 int64_t time);
+void track_free(const void *ptr, int64_t time);
+
+struct MemorySpaceStats {
+  NameID space;
+  uint64_t peakBytes;
+  int64_t peakTime;
+  uint64_t finalBytes;
+  uint64_t allocations;
+  uint64_t deallocations;
+};
+
+// Usage from time until the next sample: bytes at the last change in that
+// time, and the most bytes at any point in it
+struct MemorySample {
+  NameID space;
+  int64_t time;
+  uint64_t bytes;
+  uint64_t maxBytes;
+};
+
+// the allocations named name alive at the peak of space
+struct MemoryPeakUse {
+  NameID space;
+  NameID name;
+  uint64_t count;
+  uint64_t bytes;
+};
+
+struct LiveAllocation {
+  NameID space;
+  NameID name;
+  uint64_t address;
+  uint64_t size;
+  int64_t time; // when it was allocated
+};
+
+struct MemoryReport {
+  std::vector<MemorySpaceStats> spaces;
+  std::vector<MemorySample> timeline;
+  std::vector<MemoryPeakUse> peaks;
+  std::vector<LiveAllocation> leaks; // allocations not freed yet
+  uint64_t unmatchedFrees;           // frees of pointers never allocated
+};
+
+// Everything tracked so far. The timeline ends with the current usage
+MemoryReport memory_report(int64_t time);
+
+} // namespace lib
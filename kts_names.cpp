@@ -0,0 +1,68 @@
+#include "kts_names.hpp"
+
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace lib {
+
+static std::mutex mutex;
+// deque so references to the strings stay valid as it grows
+static std::deque<std::string> storage;
+static std::vector<const char *> byID;
+static std::unordered_map<std::string_view, NameID> byName;
+
+static NameID intern_slow(const char *name) {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = byName.find(std::string_view(name));
+  if (it != byName.end()) {
+    return it->second;
+  }
+  const std::string &s = storage.emplace_back(name);
+  const NameID id = NameID(byID.size());
+  byID.push_back(s.c_str());
+  byName.emplace(std::string_view(s), id);
+  return id;
+}
+
+// Kokkos tends to pass the same pointer for the same label, so each thread
+// keeps a direct-mapped cache from pointer to handle. Pointers can be reused
+// for different labels, so a hit is confirmed by comparing contents.
+namespace {
+struct CacheEntry {
+  const char *ptr;
+  const char *interned;
+  NameID id;
+};
+} // namespace
+
+static constexpr size_t CACHE_SIZE = 256;
+static thread_local CacheEntry cache[CACHE_SIZE];
+
+NameID intern_name(const char *name) {
+  if (!name) {
+    name = "<null name>";
+  }
+  CacheEntry &e =
+      cache[(std::hash<const void *>{}(name) >> 4) & (CACHE_SIZE - 1)];
+  if (e.ptr == name && 0 == std::strcmp(e.interned, name)) {
+    return e.id;
+  }
+  const NameID id = intern_slow(name);
+  e.ptr = name;
+  e.interned = name_of(id);
+  e.id = id;
+  return id;
+}
+
+const char *name_of(NameID id) {
+  std::lock_guard<std::mutex> lock(mutex);
+  return byID[id];
+}
+
+} // namespace lib
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+
+namespace lib {
+
+// a small integer standing in for a name string
+using NameID = uint32_t;
+
+// returns the handle for name, interning it on first use.
+// Allocation-free once name has been seen by the calling thread
+NameID intern_name(const char *name);
+
+// the interned string for id. Valid for the life of the process
+const char *name_of(NameID id);
+
+} // namespace lib
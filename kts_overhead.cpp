@@ -0,0 +1,233 @@
+#include "kts_overhead.hpp"
+
+#include <array>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+
+#include "kts_histogram.hpp"
+#include "kts_timer.hpp"
+
+namespace lib {
+
+static constexpr int NUM_CALLBACKS = int(Callback::NUM_CALLBACKS);
+
+static const char *callback_name(int cb) {
+  switch (Callback(cb)) {
+  case Callback::BEGIN_SPAN:
+    return "begin_span";
+  case Callback::END_SPAN:
+    return "end_span";
+  case Callback::PUSH_REGION:
+    return "push_region";
+  case Callback::POP_REGION:
+    return "pop_region";
+  case Callback::EVENT:
+    return "event";
+  case Callback::SECTION:
+    return "section";
+  case Callback::NUM_CALLBACKS:
+    break;
+  }
+  return "unknown";
+}
+
+static uint64_t timeEvery = 16;
+
+namespace {
+
+// one thread's callbacks
+struct CallbackStats {
+  std::array<uint64_t, NUM_CALLBACKS> calls{};
+  std::array<uint64_t, NUM_CALLBACKS> timed{};
+  std::array<uint64_t, NUM_CALLBACKS> timedNs{};
+  std::array<uint64_t, NUM_CALLBACKS> maxNs{};
+  std::array<schema::Histogram, NUM_CALLBACKS> hist;
+  // calls of each kind until the next timed one
+  std::array<uint64_t, NUM_CALLBACKS> untilTimed{};
+};
+
+// the writer thread
+struct WriterStats {
+  uint64_t passes = 0;
+  uint64_t records = 0;
+  uint64_t insertNs = 0;
+  uint64_t maxDepth = 0;
+  schema::Histogram depth;
+  uint64_t maxLatencyNs = 0;
+  schema::Histogram latency;
+  uint64_t commits = 0;
+  uint64_t commitNs = 0;
+};
+
+} // namespace
+
+// Every thread's stats, kept after the thread exits so finalize can read them
+static std::mutex tablesMutex;
+static std::vector<std::unique_ptr<CallbackStats>> tables;
+static thread_local CallbackStats *table = nullptr;
+static WriterStats writerStats;
+
+static CallbackStats *new_table() {
+  std::lock_guard<std::mutex> lock(tablesMutex);
+  tables.push_back(std::make_unique<CallbackStats>());
+  return tables.back().get();
+}
+
+void init_overhead(uint64_t every) {
+  std::lock_guard<std::mutex> lock(tablesMutex);
+  timeEvery = every;
+  for (const auto &t : tables) {
+    *t = CallbackStats{};
+  }
+  writerStats = WriterStats{};
+}
+
+namespace detail {
+
+uint64_t begin_callback(Callback cb) {
+  if (!table) {
+    table = new_table();
+  }
+  const int i = int(cb);
+  ++table->calls[i];
+  if (0 == timeEvery || table->untilTimed[i]--) {
+    return 0;
+  }
+  table->untilTimed[i] = timeEvery - 1;
+  return now_ns();
+}
+
+void end_callback(Callback cb, uint64_t startNs) {
+  const uint64_t ns = now_ns() - startNs;
+  const int i = int(cb);
+  ++table->timed[i];
+  table->timedNs[i] += ns;
+  table->maxNs[i] = ns > table->maxNs[i] ? ns : table->maxNs[i];
+  table->hist[i].add(ns);
+}
+
+} // namespace detail
+
+void note_drain(uint64_t depth, uint64_t n, uint64_t ns) {
+  WriterStats &w = writerStats;
+  ++w.passes;
+  w.records += n;
+  w.insertNs += ns;
+  w.maxDepth = depth > w.maxDepth ? depth : w.maxDepth;
+  w.depth.add(depth);
+}
+
+void note_drain_latency(int64_t waitNs) {
+  const uint64_t ns = waitNs > 0 ? uint64_t(waitNs) : 0;
+  WriterStats &w = writerStats;
+  w.maxLatencyNs = ns > w.maxLatencyNs ? ns : w.maxLatencyNs;
+  w.latency.add(ns);
+}
+
+void note_commit(uint64_t ns) {
+  ++writerStats.commits;
+  writerStats.commitNs += ns;
+}
+
+// all threads' callback stats, merged
+static CallbackStats merged_callbacks() {
+  CallbackStats m;
+  std::lock_guard<std::mutex> lock(tablesMutex);
+  for (const auto &t : tables) {
+    for (int i = 0; i < NUM_CALLBACKS; ++i) {
+      m.calls[i] += t->calls[i];
+      m.timed[i] += t->timed[i];
+      m.timedNs[i] += t->timedNs[i];
+      m.maxNs[i] = t->maxNs[i] > m.maxNs[i] ? t->maxNs[i] : m.maxNs[i];
+      m.hist[i].merge(t->hist[i]);
+    }
+  }
+  return m;
+}
+
+// estimated seconds spent in callbacks of kind i, from the timed ones
+static double callback_seconds(const CallbackStats &m, int i) {
+  if (0 == m.timed[i]) {
+    return 0;
+  }
+  return double(m.timedNs[i]) / double(m.timed[i]) * double(m.calls[i]) *
+         1e-9;
+}
+
+namespace {
+
+// every kind of callback together
+struct CallbackTotals {
+  explicit CallbackTotals(const CallbackStats &m) {
+    for (int i = 0; i < NUM_CALLBACKS; ++i) {
+      calls += m.calls[i];
+      seconds += callback_seconds(m, i);
+      hist.merge(m.hist[i]);
+    }
+  }
+  uint64_t calls = 0;
+  double seconds = 0;
+  schema::Histogram hist;
+};
+
+} // namespace
+
+static double records_per_second(const WriterStats &w) {
+  return w.insertNs ? double(w.records) / (w.insertNs * 1e-9) : 0;
+}
+
+std::vector<OverheadStat> overhead_stats(uint64_t queueCapacity) {
+  std::vector<OverheadStat> out;
+  const CallbackStats m = merged_callbacks();
+  for (int i = 0; i < NUM_CALLBACKS; ++i) {
+    const std::string name = callback_name(i);
+    out.push_back({name + "_calls", double(m.calls[i])});
+    out.push_back({name + "_seconds", callback_seconds(m, i)});
+    out.push_back({name + "_p50_ns", double(m.hist[i].quantile(0.5))});
+    out.push_back({name + "_p99_ns", double(m.hist[i].quantile(0.99))});
+    out.push_back({name + "_max_ns", double(m.maxNs[i])});
+  }
+  const CallbackTotals all(m);
+  out.push_back({"callback_calls", double(all.calls)});
+  out.push_back({"callback_seconds", all.seconds});
+  out.push_back({"callback_p50_ns", double(all.hist.quantile(0.5))});
+  out.push_back({"callback_p99_ns", double(all.hist.quantile(0.99))});
+  out.push_back({"callback_time_every", double(timeEvery)});
+
+  const WriterStats &w = writerStats;
+  out.push_back({"queue_capacity", double(queueCapacity)});
+  out.push_back({"queue_depth_p50", double(w.depth.quantile(0.5))});
+  out.push_back({"queue_depth_p99", double(w.depth.quantile(0.99))});
+  out.push_back({"queue_depth_max", double(w.maxDepth)});
+  out.push_back({"drain_latency_p50_ns", double(w.latency.quantile(0.5))});
+  out.push_back({"drain_latency_p99_ns", double(w.latency.quantile(0.99))});
+  out.push_back({"drain_latency_max_ns", double(w.maxLatencyNs)});
+  out.push_back({"drain_passes", double(w.passes)});
+  out.push_back({"records_written", double(w.records)});
+  out.push_back({"insert_seconds", w.insertNs * 1e-9});
+  out.push_back({"insert_records_per_second", records_per_second(w)});
+  out.push_back({"commits", double(w.commits)});
+  out.push_back({"commit_seconds", w.commitNs * 1e-9});
+  return out;
+}
+
+std::string overhead_summary(uint64_t queueCapacity) {
+  const CallbackTotals all(merged_callbacks());
+  const WriterStats &w = writerStats;
+  char buf[512];
+  std::snprintf(
+      buf, sizeof(buf),
+      "KTS: %.6f s in %llu callbacks (p50 %llu ns, p99 %llu ns), "
+      "%llu records at %.0f/s, queue max %llu/%llu, drain p99 %llu ns",
+      all.seconds, static_cast<unsigned long long>(all.calls),
+      static_cast<unsigned long long>(all.hist.quantile(0.5)),
+      static_cast<unsigned long long>(all.hist.quantile(0.99)),
+      static_cast<unsigned long long>(w.records), records_per_second(w),
+      static_cast<unsigned long long>(w.maxDepth),
+      static_cast<unsigned long long>(queueCapacity),
+      static_cast<unsigned long long>(w.latency.quantile(0.99)));
+  return buf;
+}
+
+} // namespace lib
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace lib {
+
+// Measurements of KTS itself, written to KtsStats at finalize.
+//
+// Every callback is counted. Every KTS_SELF_TIME_EVERY-th callback on a thread
+// is also timed, so the timer reads cost little on average; the total time in
+// callbacks is estimated from the timed ones.
+
+enum class Callback : uint8_t {
+  BEGIN_SPAN, // kernels, fences and deep copies
+  END_SPAN,
+  PUSH_REGION,
+  POP_REGION,
+  EVENT,   // allocations and profile events
+  SECTION, // starts and stops of profile sections
+  NUM_CALLBACKS
+};
+
+// time one in every timeEvery callbacks per thread, none if 0. Forgets
+// everything measured so far
+void init_overhead(uint64_t timeEvery);
+
+namespace detail {
+// the calling thread's timer start for cb, or 0 if this call is not timed
+uint64_t begin_callback(Callback cb);
+void end_callback(Callback cb, uint64_t startNs);
+} // namespace detail
+
+// counts the callback it is declared in, and times it if it is sampled
+class CallbackTimer {
+public:
+  explicit CallbackTimer(Callback cb)
+      : cb_(cb), start_(detail::begin_callback(cb)) {}
+  ~CallbackTimer() {
+    if (start_) {
+      detail::end_callback(cb_, start_);
+    }
+  }
+
+  CallbackTimer(const CallbackTimer &) = delete;
+  CallbackTimer &operator=(const CallbackTimer &) = delete;
+
+private:
+  Callback cb_;
+  uint64_t start_;
+};
+
+// Writer-thread measurements. Only the writer thread may call these.
+
+// a drain pass that found depth records buffered and wrote n of them in ns
+void note_drain(uint64_t depth, uint64_t n, uint64_t ns);
+// a record written waitNs after it was produced
+void note_drain_latency(int64_t waitNs);
+// a commit and the begin of the next transaction, which took ns
+void note_commit(uint64_t ns);
+
+struct OverheadStat {
+  std::string name;
+  double value;
+};
+
+// Everything measured, as KtsStats rows. Not safe to call while other threads
+// are still making callbacks
+std::vector<OverheadStat> overhead_stats(uint64_t queueCapacity);
+
+// the headline numbers on one line
+std::string overhead_summary(uint64_t queueCapacity);
+
+} // namespace lib
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+
+namespace lib {
+
+// a fixed-capacity single-producer / single-consumer ring buffer of POD records
+template <typename T> class SpscRing {
+  static_assert(std::is_trivially_copyable_v<T>,
+                "SpscRing records must be trivially copyable");
+
+public:
+  // capacity is rounded up to a power of two
+  explicit SpscRing(size_t capacity)
+      : capacity_(round_up(capacity)), mask_(capacity_ - 1),
+        buf_(new T[capacity_]) {}
+
+  SpscRing(const SpscRing &) = delete;
+  SpscRing &operator=(const SpscRing &) = delete;
+
+  // producer side. returns false if the ring is full
+  bool try_push(const T &t) {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    if (head - tailCache_ == capacity_) {
+      tailCache_ = tail_.load(std::memory_order_acquire);
+      if (head - tailCache_ == capacity_) {
+        return false;
+      }
+    }
+    buf_[head & mask_] = t;
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // consumer side. calls f on up to max records, returns the number consumed
+  template <typename F> size_t drain(F &&f, size_t max) {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    const size_t head = head_.load(std::memory_order_acquire);
+    size_t n = head - tail;
+    if (n > max) {
+      n = max;
+    }
+    for (size_t i = 0; i < n; ++i) {
+      f(buf_[(tail + i) & mask_]);
+    }
+    tail_.store(tail + n, std::memory_order_release);
+    return n;
+  }
+
+  // approximate number of buffered records, safe to call from either side
+  size_t size() const {
+    return head_.load(std::memory_order_acquire) -
+           tail_.load(std::memory_order_acquire);
+  }
+
+  size_t capacity() const { return capacity_; }
+
+  // the capacity a ring asked for capacity n has
+  static size_t round_up(size_t n) {
+    size_t c = 1;
+    while (c < n) {
+      c <<= 1;
+    }
+    return c;
+  }
+
+private:
+  static constexpr size_t CACHE_LINE = 64;
+
+  const size_t capacity_;
+  const size_t mask_;
+  std::unique_ptr<T[]> buf_;
+
+  // written by the producer
+  alignas(CACHE_LINE) std::atomic<size_t> head_{0};
+  size_t tailCache_ = 0;
+  // written by the consumer
+  alignas(CACHE_LINE) std::atomic<size_t> tail_{0};
+};
+
+// A lock-free registry of per-producer-thread rings, drained by one consumer.
+// Rings are never freed while the registry is alive; a ring released by an
+// exiting thread is reused by the next thread that asks for one.
+template <typename T> class ThreadQueues {
+public:
+  struct Queue {
+    explicit Queue(size_t capacity) : ring(capacity) {}
+    SpscRing<T> ring;
+    std::atomic<bool> owned{true};
+    Queue *next = nullptr;
+  };
+
+  explicit ThreadQueues(size_t capacity) : capacity_(capacity) {}
+
+  // the capacity of queues registered from now on
+  void set_capacity(size_t capacity) {
+    capacity_.store(capacity, std::memory_order_relaxed);
+  }
+
+  // records each queue registered from now on holds
+  size_t capacity() const {
+    return SpscRing<T>::round_up(capacity_.load(std::memory_order_relaxed));
+  }
+
+  ThreadQueues(const ThreadQueues &) = delete;
+  ThreadQueues &operator=(const ThreadQueues &) = delete;
+
+  ~ThreadQueues() {
+    Queue *q = head_.load(std::memory_order_acquire);
+    while (q) {
+      Queue *next = q->next;
+      delete q;
+      q = next;
+    }
+  }
+
+  // claim a released queue, or register a new one
+  Queue *acquire() {
+    for (Queue *q = head_.load(std::memory_order_acquire); q; q = q->next) {
+      bool expected = false;
+      if (!q->owned.load(std::memory_order_relaxed) &&
+          q->owned.compare_exchange_strong(expected, true,
+                                           std::memory_order_acquire)) {
+        return q;
+      }
+    }
+    Queue *q = new Queue(capacity_.load(std::memory_order_relaxed));
+    q->next = head_.load(std::memory_order_relaxed);
+    while (!head_.compare_exchange_weak(q->next, q, std::memory_order_release,
+                                        std::memory_order_relaxed)) {
+    }
+    return q;
+  }
+
+  // the producer thread is done with q. Records already in it are still
+  // drained.
+  void release(Queue *q) { q->owned.store(false, std::memory_order_release); }
+
+  // approximate number of records in the fullest queue
+  size_t max_size() const {
+    size_t n = 0;
+    for (Queue *q = head_.load(std::memory_order_acquire); q; q = q->next) {
+      const size_t m = q->ring.size();
+      n = m > n ? m : n;
+    }
+    return n;
+  }
+
+  // drain every queue, returns the number of records consumed
+  template <typename F> size_t drain(F &&f) {
+    size_t n = 0;
+    for (Queue *q = head_.load(std::memory_order_acquire); q; q = q->next) {
+      n += q->ring.drain(f, q->ring.capacity());
+    }
+    return n;
+  }
+
+private:
+  std::atomic<size_t> capacity_;
+  std::atomic<Queue *> head_{nullptr};
+};
+
+} // namespace lib
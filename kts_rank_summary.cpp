@@ -0,0 +1,198 @@
+#include "kts_rank_summary.hpp"
+
+#if defined(KTS_ENABLE_MPI)
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <utility>
+
+#include <mpi.h>
+#include <sqlite3.h>
+#endif
+
+namespace lib {
+
+#if defined(KTS_ENABLE_MPI)
+
+// a RankStat as bytes: kind, name length, name, count, total, min, max
+static void pack(std::vector<char> &buf, const RankStat &s) {
+  auto put = [&](const void *p, size_t n) {
+    const char *c = static_cast<const char *>(p);
+    buf.insert(buf.end(), c, c + n);
+  };
+  const uint8_t kind = uint8_t(s.kind);
+  const uint32_t len = uint32_t(s.name.size());
+  put(&kind, sizeof(kind));
+  put(&len, sizeof(len));
+  put(s.name.data(), len);
+  put(&s.count, sizeof(s.count));
+  put(&s.total, sizeof(s.total));
+  put(&s.min, sizeof(s.min));
+  put(&s.max, sizeof(s.max));
+}
+
+// the RankStat at p, advancing p past it
+static RankStat unpack(const char *&p) {
+  auto get = [&](void *dst, size_t n) {
+    std::memcpy(dst, p, n);
+    p += n;
+  };
+  RankStat s;
+  uint8_t kind;
+  uint32_t len;
+  get(&kind, sizeof(kind));
+  get(&len, sizeof(len));
+  s.kind = schema::Kind(kind);
+  s.name.assign(p, len);
+  p += len;
+  get(&s.count, sizeof(s.count));
+  get(&s.total, sizeof(s.total));
+  get(&s.min, sizeof(s.min));
+  get(&s.max, sizeof(s.max));
+  return s;
+}
+
+namespace {
+
+// one name and kind over all ranks
+struct Summary {
+  int64_t ranks = 0;
+  uint64_t count = 0;
+  double total = 0;
+  double min = 0;
+  double max = 0;
+  double minRankTotal = 0;
+  double maxRankTotal = 0;
+  int maxRank = 0;
+
+  void add(int rank, const RankStat &s) {
+    if (0 == ranks || s.min < min) {
+      min = s.min;
+    }
+    if (0 == ranks || s.max > max) {
+      max = s.max;
+    }
+    if (0 == ranks || s.total < minRankTotal) {
+      minRankTotal = s.total;
+    }
+    if (0 == ranks || s.total > maxRankTotal) {
+      maxRankTotal = s.total;
+      maxRank = rank;
+    }
+    ++ranks;
+    count += s.count;
+    total += s.total;
+  }
+};
+
+} // namespace
+
+using SummaryKey = std::pair<schema::Kind, std::string>;
+
+static void write_summaries(const std::map<SummaryKey, Summary> &summaries,
+                            int numRanks, const std::string &path) {
+  sqlite3 *db = nullptr;
+  if (sqlite3_open(path.c_str(), &db)) {
+    std::cerr << "KTS: can't open " << path << ": " << sqlite3_errmsg(db)
+              << "\n";
+    sqlite3_close(db);
+    return;
+  }
+  // a database with no records but the usual dictionaries, so it reads like
+  // any other
+  schema::create_tables(db);
+  schema::init(db);
+  sqlite3_exec(db, "BEGIN", 0, 0, 0);
+  const std::string version = std::to_string(schema::VERSION);
+  const std::string ranks = std::to_string(numRanks);
+  schema::insert(db, schema::Meta{"schema_version", version.c_str()});
+  schema::insert(db, schema::Meta{"ranks", ranks.c_str()});
+  for (int k = 0; k < int(schema::Kind::NUM_KINDS); ++k) {
+    schema::insert(db, schema::KindName{schema::Kind(k)});
+  }
+  std::map<std::string, int64_t> names;
+  for (const auto &kv : summaries) {
+    const std::string &name = kv.first.second;
+    auto it = names.find(name);
+    if (it == names.end()) {
+      it = names.emplace(name, int64_t(names.size())).first;
+      schema::insert(db, schema::Name{it->second, name.c_str()});
+    }
+    const Summary &s = kv.second;
+    schema::insert(db, schema::RankSummary{
+                           it->second, kv.first.first, s.ranks,
+                           int64_t(s.count), s.total, s.min, s.max,
+                           s.minRankTotal, s.maxRankTotal, s.maxRank});
+  }
+  sqlite3_exec(db, "COMMIT", 0, 0, 0);
+  schema::finalize(db);
+  sqlite3_close(db);
+  std::cerr << "KTS: wrote " << summaries.size() << " summaries of "
+            << numRanks << " ranks to " << path << "\n";
+}
+
+bool write_rank_summary(const std::vector<RankStat> &stats,
+                        const std::string &path) {
+  int initialized = 0, finalized = 0;
+  MPI_Initialized(&initialized);
+  MPI_Finalized(&finalized);
+  if (!initialized || finalized) {
+    return false;
+  }
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  std::vector<char> buf;
+  for (const RankStat &s : stats) {
+    pack(buf, s);
+  }
+  const int bytes = int(buf.size());
+  std::vector<int> counts(rank == 0 ? size : 0);
+  MPI_Gather(&bytes, 1, MPI_INT, counts.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+  std::vector<int> displs(counts.size());
+  int64_t all = 0;
+  for (size_t r = 0; r < counts.size(); ++r) {
+    displs[r] = int(all);
+    all += counts[r];
+  }
+  // Gatherv counts in ints
+  int fits = all <= std::numeric_limits<int>::max();
+  MPI_Bcast(&fits, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  if (!fits) {
+    if (rank == 0) {
+      std::cerr << "KTS: rank summaries too large to gather\n";
+    }
+    return true;
+  }
+  std::vector<char> gathered(all);
+  MPI_Gatherv(buf.data(), bytes, MPI_CHAR, gathered.data(), counts.data(),
+              displs.data(), MPI_CHAR, 0, MPI_COMM_WORLD);
+  if (rank != 0) {
+    return true;
+  }
+
+  std::map<SummaryKey, Summary> summaries;
+  for (int r = 0; r < size; ++r) {
+    const char *p = gathered.data() + displs[r];
+    const char *end = p + counts[r];
+    while (p < end) {
+      RankStat s = unpack(p);
+      summaries[SummaryKey(s.kind, std::move(s.name))].add(r, s);
+    }
+  }
+  write_summaries(summaries, size, path);
+  return true;
+}
+
+#else
+
+bool write_rank_summary(const std::vector<RankStat> &, const std::string &) {
+  return false;
+}
+
+#endif // KTS_ENABLE_MPI
+
+} // namespace lib
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "kts_schema.hpp"
+
+namespace lib {
+
+// one rank's statistics for a name and kind. Times are in seconds
+struct RankStat {
+  schema::Kind kind;
+  std::string name;
+  uint64_t count;
+  double total;
+  double min;
+  double max;
+};
+
+// Collect every rank's stats on rank 0, which writes them per name and kind
+// to a new database at path. Collective over MPI_COMM_WORLD, with a fixed
+// number of collectives however long the trace. Returns false without doing
+// anything if KTS was built without MPI or MPI is not running
+bool write_rank_summary(const std::vector<RankStat> &stats,
+                        const std::string &path);
+
+} // namespace lib
@@ -0,0 +1,196 @@
+#include "kts_sections.hpp"
+
+#include <atomic>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+
+namespace lib {
+
+namespace {
+
+struct Accumulator {
+  uint64_t count = 0;
+  int64_t total = 0;
+  int64_t min = std::numeric_limits<int64_t>::max();
+  int64_t max = 0;
+};
+
+// the start of a section running on a thread, and the ID it was started as
+struct Start {
+  int64_t time = -1; // -1 when not running
+  uint32_t id = NO_SECTION;
+};
+
+struct ThreadSections {
+  std::vector<Accumulator> byName;
+  std::vector<Start> starts; // by section slot
+};
+
+} // namespace
+
+// The name of each section slot, in chunks that never move once published, so
+// that start and stop read it without a lock
+static constexpr size_t CHUNK_BITS = 12;
+static constexpr size_t CHUNK_SIZE = size_t(1) << CHUNK_BITS;
+static constexpr size_t MAX_CHUNKS = 1024;
+static std::atomic<std::atomic<NameID> *> chunks[MAX_CHUNKS];
+
+// A section ID is its slot in the low bits and the slot's generation in the
+// high bits. Destroying a section bumps the generation of the ID its slot is
+// reused under, so a start left running on another thread by the old section
+// does not match the new one. Generations wrap before reaching NO_SECTION
+static constexpr uint32_t SLOT_BITS = 22;
+static constexpr uint32_t SLOT_MASK = (uint32_t(1) << SLOT_BITS) - 1;
+static constexpr uint32_t GENERATIONS = NO_SECTION >> SLOT_BITS;
+static_assert(MAX_CHUNKS * CHUNK_SIZE == size_t(1) << SLOT_BITS,
+              "section slots and IDs disagree");
+
+static uint32_t slot_of(uint32_t id) { return id & SLOT_MASK; }
+
+// owns the chunks, and hands out IDs
+static std::mutex sectionsMutex;
+static std::vector<std::unique_ptr<std::atomic<NameID>[]>> chunkStorage;
+static uint32_t nextSlot = 0;
+static std::vector<uint32_t> freeIDs; // the next ID of each free slot
+
+uint32_t create_section(NameID name) {
+  std::lock_guard<std::mutex> lock(sectionsMutex);
+  uint32_t id;
+  if (!freeIDs.empty()) {
+    id = freeIDs.back();
+    freeIDs.pop_back();
+  } else if (nextSlot < MAX_CHUNKS * CHUNK_SIZE) {
+    id = nextSlot++;
+    if ((id >> CHUNK_BITS) == chunkStorage.size()) {
+      chunkStorage.push_back(
+          std::make_unique<std::atomic<NameID>[]>(CHUNK_SIZE));
+      chunks[id >> CHUNK_BITS].store(chunkStorage.back().get(),
+                                     std::memory_order_release);
+    }
+  } else {
+    static bool warned = false;
+    if (!warned) {
+      std::cerr << "KTS: too many profile sections alive, some will not be "
+                   "timed\n";
+      warned = true;
+    }
+    return NO_SECTION;
+  }
+  const uint32_t slot = slot_of(id);
+  chunks[slot >> CHUNK_BITS]
+      .load(std::memory_order_relaxed)[slot & (CHUNK_SIZE - 1)]
+      .store(name, std::memory_order_release);
+  return id;
+}
+
+NameID section_name(uint32_t id) {
+  const uint32_t slot = slot_of(id);
+  return chunks[slot >> CHUNK_BITS]
+      .load(std::memory_order_acquire)[slot & (CHUNK_SIZE - 1)]
+      .load(std::memory_order_acquire);
+}
+
+// Every thread's sections, kept after the thread exits so finalize can read
+// them
+static std::mutex tablesMutex;
+static std::vector<std::unique_ptr<ThreadSections>> tables;
+static thread_local ThreadSections *table = nullptr;
+
+static ThreadSections &thread_sections() {
+  if (!table) {
+    std::lock_guard<std::mutex> lock(tablesMutex);
+    tables.push_back(std::make_unique<ThreadSections>());
+    table = tables.back().get();
+  }
+  return *table;
+}
+
+static Start &start_of(uint32_t id) {
+  std::vector<Start> &starts = thread_sections().starts;
+  const uint32_t slot = slot_of(id);
+  if (slot >= starts.size()) {
+    starts.resize(slot + 1);
+  }
+  return starts[slot];
+}
+
+void destroy_section(uint32_t id) {
+  if (id == NO_SECTION) {
+    return;
+  }
+  start_of(id) = Start{};
+  const uint32_t generation = ((id >> SLOT_BITS) + 1) % GENERATIONS;
+  std::lock_guard<std::mutex> lock(sectionsMutex);
+  freeIDs.push_back((generation << SLOT_BITS) | slot_of(id));
+}
+
+void init_sections() {
+  std::lock_guard<std::mutex> lock(tablesMutex);
+  for (const auto &t : tables) {
+    t->byName.assign(t->byName.size(), Accumulator{});
+    t->starts.assign(t->starts.size(), Start{});
+  }
+}
+
+void start_section(uint32_t id, int64_t time) {
+  if (id != NO_SECTION) {
+    start_of(id) = Start{time, id};
+  }
+}
+
+int64_t stop_section(uint32_t id, int64_t time) {
+  if (id == NO_SECTION) {
+    return -1;
+  }
+  Start &running = start_of(id);
+  const int64_t start = running.time;
+  if (start < 0 || running.id != id) {
+    return -1;
+  }
+  running = Start{};
+
+  const NameID name = section_name(id);
+  std::vector<Accumulator> &byName = table->byName;
+  if (name >= byName.size()) {
+    byName.resize(name + 1);
+  }
+  Accumulator &a = byName[name];
+  const int64_t ns = time - start;
+  ++a.count;
+  a.total += ns;
+  a.min = ns < a.min ? ns : a.min;
+  a.max = ns > a.max ? ns : a.max;
+  return start;
+}
+
+std::vector<SectionStats> section_stats() {
+  std::vector<Accumulator> merged;
+  {
+    std::lock_guard<std::mutex> lock(tablesMutex);
+    for (const auto &t : tables) {
+      if (t->byName.size() > merged.size()) {
+        merged.resize(t->byName.size());
+      }
+      for (size_t i = 0; i < t->byName.size(); ++i) {
+        const Accumulator &a = t->byName[i];
+        Accumulator &m = merged[i];
+        m.count += a.count;
+        m.total += a.total;
+        m.min = a.min < m.min ? a.min : m.min;
+        m.max = a.max > m.max ? a.max : m.max;
+      }
+    }
+  }
+  std::vector<SectionStats> out;
+  for (size_t i = 0; i < merged.size(); ++i) {
+    const Accumulator &m = merged[i];
+    if (m.count) {
+      out.push_back(SectionStats{NameID(i), m.count, m.total, m.min, m.max});
+    }
+  }
+  return out;
+}
+
+} // namespace lib
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "kts_names.hpp"
+
+namespace lib {
+
+// Kokkos profile sections, timed without going through the record queues.
+//
+// Every section created gets an ID of its own, so sections nest even when they
+// share a name. Times accumulate by name, so the many sections an application
+// creates under one name, e.g. a ProfilingSection inside a loop, are timed
+// together. Each thread keeps its own accumulators, indexed by name, and the
+// start of each section running on it, indexed by section ID.
+
+// returned by create_section when there are too many sections alive
+constexpr uint32_t NO_SECTION = UINT32_MAX;
+
+// A new section ID for a section called name. The slots of destroyed sections
+// are reused, under a different ID
+uint32_t create_section(NameID name);
+// a section still running on any thread is forgotten: stopping it there, or
+// the section that reuses its slot, is not timed
+void destroy_section(uint32_t id);
+NameID section_name(uint32_t id);
+
+// forgets everything accumulated so far
+void init_sections();
+
+// time is ns since init. Starting a section already running on the calling
+// thread restarts it
+void start_section(uint32_t id, int64_t time);
+// Returns when the section started on the calling thread, or -1 if it was not
+// running there
+int64_t stop_section(uint32_t id, int64_t time);
+
+struct SectionStats {
+  NameID name;
+  uint64_t count;
+  int64_t total; // ns
+  int64_t min;
+  int64_t max;
+};
+
+// every section name stopped at least once, over all threads. Not safe to
+// call while other threads are still making callbacks
+std::vector<SectionStats> section_stats();
+
+} // namespace lib
@@ -0,0 +1,130 @@
+#include "kts_timer.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#if defined(KTS_HAVE_TSC)
+#include <cpuid.h>
+#endif
+
+namespace lib {
+
+namespace detail {
+Timer timer = Timer::STEADY;
+TscConversion tsc;
+} // namespace detail
+
+#if defined(KTS_HAVE_TSC)
+
+// the first calibration point, for the long-run tick rate
+static uint64_t firstTicks = 0;
+static uint64_t firstNs = 0;
+static uint64_t lastRecalibration = 0;
+
+// re-fit about this often, and take this long to slew out an error
+static constexpr uint64_t RECALIBRATE_NS = 1000000000;
+
+// a TSC that ticks at a constant rate through frequency and power changes
+static bool invariant_tsc() {
+  unsigned int eax, ebx, ecx, edx;
+  if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx)) {
+    return false;
+  }
+  return edx & (1u << 8);
+}
+
+static void set_conversion(uint64_t baseTicks, uint64_t baseNs,
+                           double nsPerTick) {
+  detail::TscConversion &c = detail::tsc;
+  const uint32_t seq = c.seq.load(std::memory_order_relaxed);
+  c.seq.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  c.baseTicks.store(baseTicks, std::memory_order_relaxed);
+  c.baseNs.store(baseNs, std::memory_order_relaxed);
+  c.nsPerTick.store(nsPerTick, std::memory_order_relaxed);
+  c.seq.store(seq + 2, std::memory_order_release);
+}
+
+static void calibrate_tsc() {
+  firstTicks = __rdtsc();
+  firstNs = detail::steady_ns();
+  const uint64_t until = firstNs + 10000000;
+  uint64_t ns;
+  do {
+    ns = detail::steady_ns();
+  } while (ns < until);
+  const uint64_t ticks = __rdtsc();
+  set_conversion(ticks, ns, double(ns - firstNs) / double(ticks - firstTicks));
+  lastRecalibration = ns;
+}
+
+#endif
+
+Timer init_timer(const char *name) {
+  const std::string s(name ? name : "steady");
+  Timer timer = Timer::STEADY;
+  if (s == "raw") {
+#if defined(CLOCK_MONOTONIC_RAW)
+    timer = Timer::MONOTONIC_RAW;
+#else
+    std::cerr << "KTS: CLOCK_MONOTONIC_RAW is not available, using steady\n";
+#endif
+  } else if (s == "tsc") {
+#if defined(KTS_HAVE_TSC)
+    if (invariant_tsc()) {
+      calibrate_tsc();
+      timer = Timer::TSC;
+    } else {
+      std::cerr << "KTS: the TSC is not invariant, using steady\n";
+    }
+#else
+    std::cerr << "KTS: no TSC on this architecture, using steady\n";
+#endif
+  } else if (s != "steady") {
+    std::cerr << "KTS: unknown KTS_TIMER=" << s << ", using steady\n";
+  }
+  detail::timer = timer;
+  return timer;
+}
+
+Timer current_timer() { return detail::timer; }
+
+const char *timer_name(Timer timer) {
+  switch (timer) {
+  case Timer::STEADY:
+    return "steady";
+  case Timer::MONOTONIC_RAW:
+    return "raw";
+  case Timer::TSC:
+    return "tsc";
+  }
+  return "unknown";
+}
+
+void recalibrate_timer() {
+#if defined(KTS_HAVE_TSC)
+  if (detail::timer != Timer::TSC) {
+    return;
+  }
+  const uint64_t ns = detail::steady_ns();
+  if (ns - lastRecalibration < RECALIBRATE_NS) {
+    return;
+  }
+  lastRecalibration = ns;
+
+  // Continue from where the current conversion puts us, so time never jumps
+  // back, and pick a rate that brings us onto steady_clock over the next
+  // period on top of the long-run tick rate
+  const uint64_t ticks = __rdtsc();
+  const uint64_t converted = detail::tsc_ns(ticks);
+  const double rate = double(ns - firstNs) / double(ticks - firstTicks);
+  const double error = std::clamp(double(int64_t(ns - converted)),
+                                  -0.1 * RECALIBRATE_NS, 0.1 * RECALIBRATE_NS);
+  set_conversion(ticks, converted,
+                 rate * (RECALIBRATE_NS + error) / RECALIBRATE_NS);
+#endif
+}
+
+} // namespace lib
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define KTS_HAVE_TSC
+#endif
+
+namespace lib {
+
+// where timestamps come from (KTS_TIMER)
+enum class Timer : uint8_t {
+  STEADY,        // std::chrono::steady_clock
+  MONOTONIC_RAW, // clock_gettime(CLOCK_MONOTONIC_RAW)
+  TSC            // the x86 time-stamp counter, calibrated against STEADY
+};
+
+// Select a timer by name: "steady", "raw" or "tsc". Unknown names and timers
+// this machine cannot use fall back to "steady". Returns the timer in use
+Timer init_timer(const char *name);
+
+Timer current_timer();
+const char *timer_name(Timer timer);
+
+// Re-fit the TSC conversion to steady_clock. Meant to be called often from one
+// thread (the writer); it only does work about once a second, and nothing for
+// the other timers
+void recalibrate_timer();
+
+namespace detail {
+
+extern Timer timer;
+
+// ns = baseNs + (ticks - baseTicks) * nsPerTick, read under a seqlock so the
+// writer thread can recalibrate while callbacks convert
+struct TscConversion {
+  std::atomic<uint32_t> seq{0};
+  std::atomic<uint64_t> baseTicks{0};
+  std::atomic<uint64_t> baseNs{0};
+  std::atomic<double> nsPerTick{1};
+};
+extern TscConversion tsc;
+
+inline uint64_t steady_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+inline uint64_t raw_ns() {
+#if defined(CLOCK_MONOTONIC_RAW)
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+  return uint64_t(ts.tv_sec) * 1000000000 + uint64_t(ts.tv_nsec);
+#else
+  return steady_ns();
+#endif
+}
+
+#if defined(KTS_HAVE_TSC)
+inline uint64_t tsc_ns(uint64_t ticks) {
+  uint32_t seq;
+  uint64_t baseTicks, baseNs;
+  double nsPerTick;
+  do {
+    seq = tsc.seq.load(std::memory_order_acquire);
+    baseTicks = tsc.baseTicks.load(std::memory_order_relaxed);
+    baseNs = tsc.baseNs.load(std::memory_order_relaxed);
+    nsPerTick = tsc.nsPerTick.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+  } while ((seq & 1) || seq != tsc.seq.load(std::memory_order_relaxed));
+  // ticks read just before a recalibration may precede baseTicks
+  return baseNs + int64_t(double(int64_t(ticks - baseTicks)) * nsPerTick);
+}
+#endif
+
+} // namespace detail
+
+// nanoseconds on the selected timer, from an arbitrary origin
+inline uint64_t now_ns() {
+  switch (detail::timer) {
+#if defined(KTS_HAVE_TSC)
+  case Timer::TSC:
+    return detail::tsc_ns(__rdtsc());
+#endif
+  case Timer::MONOTONIC_RAW:
+    return detail::raw_ns();
+  default:
+    return detail::steady_ns();
+  }
+}
+
+} // namespace lib
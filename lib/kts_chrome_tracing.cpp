@@ -0,0 +1,329 @@
+#include "kts_chrome_tracing.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <unordered_map>
+
+#include "kts_clock_alignment.hpp"
+#include "kts_trace_reader.hpp"
+
+// https://docs.google.com/document/d/1CvAClvFfyA5R-PhYUmn5OOQtYMH4h6I0nSsKchNAySU/preview#heading=h.yr4qxyxotyw
+
+namespace schema {
+
+namespace {
+
+// rows formatted per batch, and batches buffered per input. Together they
+// bound the memory used for each input
+constexpr size_t BATCH_ROWS = 4096;
+constexpr size_t MAX_READY = 4;
+
+// append s as a quoted JSON string
+void append_string(std::string &out, const std::string &s) {
+  out += '"';
+  for (const char c : s) {
+    switch (c) {
+    case '"':
+      out += "\\\"";
+      break;
+    case '\\':
+      out += "\\\\";
+      break;
+    case '\n':
+      out += "\\n";
+      break;
+    case '\t':
+      out += "\\t";
+      break;
+    default:
+      if (static_cast<unsigned char>(c) < 0x20) {
+        char buf[8];
+        std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+        out += buf;
+      } else {
+        out += c;
+      }
+    }
+  }
+  out += '"';
+}
+
+// ns as microseconds: sign, whole part and three decimal digits
+struct Micros {
+  explicit Micros(int64_t ns)
+      : sign(ns < 0 ? "-" : ""), whole((ns < 0 ? -ns : ns) / 1000),
+        frac((ns < 0 ? -ns : ns) % 1000) {}
+  const char *sign;
+  long long whole;
+  long long frac;
+};
+
+// formatted JSON objects for consecutive rows of one input
+struct Batch {
+  std::vector<int64_t> start; // start time of each row
+  std::vector<uint32_t> stop; // end offset of each row in text
+  std::string text;
+};
+
+// one input database, read and formatted a batch at a time by the pool
+struct Stream {
+  Stream(const std::string &path_, const ClockAlignment &clocks_,
+         int64_t origin_)
+      : path(path_), clocks(clocks_), origin(origin_) {}
+
+  const std::string path;
+  // times are moved onto the ranks' shared timeline, starting at origin
+  const ClockAlignment clocks;
+  const int64_t origin;
+
+  // only touched by the one worker that has the stream scheduled
+  std::unique_ptr<TraceReader> reader;
+  std::vector<std::string> names; // escaped, by NameID
+  std::string unknownName;
+  std::unordered_map<uint64_t, std::string> kinds; // escaped, by kind+device
+
+  std::mutex m;
+  std::condition_variable cv;
+  std::deque<Batch> ready;
+  bool scheduled = true;
+  bool done = false;
+
+  const std::string &kind(const TraceRow &row) {
+    const uint64_t key = (uint64_t(row.kindID) << 32) | uint32_t(row.device);
+    auto it = kinds.find(key);
+    if (it == kinds.end()) {
+      std::string s;
+      append_string(s, reader->kind_string(row));
+      it = kinds.emplace(key, std::move(s)).first;
+    }
+    return it->second;
+  }
+
+  const std::string &name(int64_t nameID) {
+    if (nameID < 0) {
+      if (unknownName.empty()) {
+        append_string(unknownName, reader->name(nameID));
+      }
+      return unknownName;
+    }
+    if (size_t(nameID) >= names.size()) {
+      names.resize(nameID + 1);
+    }
+    std::string &s = names[nameID];
+    if (s.empty()) {
+      append_string(s, reader->name(nameID));
+    }
+    return s;
+  }
+
+  // read and format up to BATCH_ROWS rows. Returns false once the input is
+  // exhausted
+  bool fill(Batch &batch) {
+    if (!reader) {
+      reader = std::make_unique<TraceReader>(path);
+    }
+    batch.start.reserve(BATCH_ROWS);
+    batch.stop.reserve(BATCH_ROWS);
+
+    TraceRow row;
+    char buf[128];
+    while (batch.start.size() < BATCH_ROWS) {
+      if (!reader->next(row)) {
+        return false;
+      }
+      batch.text += "{\"name\":";
+      batch.text += name(row.nameID);
+      batch.text += ",\"cat\":";
+      batch.text += kind(row);
+
+      // time comes in as integer ns. output expects microseconds, which
+      // three decimal places print exactly
+      const int64_t start = clocks.align(row.rank, row.start) - origin;
+      const Micros ts(start);
+      if (row.type == TraceRow::Type::SPAN) {
+        const Micros dur(clocks.align(row.rank, row.stop) - origin - start);
+        std::snprintf(buf, sizeof(buf),
+                      ",\"ph\":\"X\",\"ts\":%s%lld.%03lld,"
+                      "\"dur\":%s%lld.%03lld,\"pid\":%d,\"tid\":%lld}",
+                      ts.sign, ts.whole, ts.frac, dur.sign, dur.whole, dur.frac,
+                      row.rank, static_cast<long long>(row.tid));
+      } else {
+        std::snprintf(buf, sizeof(buf),
+                      ",\"ph\":\"i\",\"s\":\"t\",\"ts\":%s%lld.%03lld,"
+                      "\"pid\":%d,\"tid\":%lld}",
+                      ts.sign, ts.whole, ts.frac, row.rank,
+                      static_cast<long long>(row.tid));
+      }
+      batch.text += buf;
+      batch.start.push_back(start);
+      batch.stop.push_back(batch.text.size());
+    }
+    return true;
+  }
+};
+
+// threads that fill batches for whichever streams are scheduled
+class Pool {
+public:
+  explicit Pool(size_t numThreads) {
+    for (size_t i = 0; i < numThreads; ++i) {
+      threads_.emplace_back([this]() { work(); });
+    }
+  }
+
+  ~Pool() {
+    {
+      std::lock_guard<std::mutex> lock(m_);
+      stop_ = true;
+    }
+    cv_.notify_all();
+    for (std::thread &t : threads_) {
+      t.join();
+    }
+  }
+
+  void schedule(Stream *s) {
+    {
+      std::lock_guard<std::mutex> lock(m_);
+      work_.push_back(s);
+    }
+    cv_.notify_one();
+  }
+
+private:
+  void work() {
+    while (true) {
+      Stream *s;
+      {
+        std::unique_lock<std::mutex> lock(m_);
+        cv_.wait(lock, [this]() { return stop_ || !work_.empty(); });
+        if (work_.empty()) {
+          return;
+        }
+        s = work_.front();
+        work_.pop_front();
+      }
+
+      Batch batch;
+      const bool more = s->fill(batch);
+
+      bool again = false;
+      {
+        std::lock_guard<std::mutex> lock(s->m);
+        if (!batch.start.empty()) {
+          s->ready.push_back(std::move(batch));
+        }
+        s->done = !more;
+        again = more && s->ready.size() < MAX_READY;
+        s->scheduled = again;
+        if (!more) {
+          s->reader.reset();
+        }
+      }
+      s->cv.notify_one();
+      if (again) {
+        schedule(s);
+      }
+    }
+  }
+
+  std::mutex m_;
+  std::condition_variable cv_;
+  std::deque<Stream *> work_;
+  bool stop_ = false;
+  std::vector<std::thread> threads_;
+};
+
+// the next batch of s, waiting for the pool if needed. Returns false once s is
+// exhausted
+bool next_batch(Pool &pool, Stream &s, Batch &batch) {
+  bool refill = false;
+  {
+    std::unique_lock<std::mutex> lock(s.m);
+    s.cv.wait(lock, [&]() { return s.done || !s.ready.empty(); });
+    if (s.ready.empty()) {
+      return false;
+    }
+    batch = std::move(s.ready.front());
+    s.ready.pop_front();
+    if (!s.done && !s.scheduled) {
+      s.scheduled = refill = true;
+    }
+  }
+  if (refill) {
+    pool.schedule(&s);
+  }
+  return true;
+}
+
+} // namespace
+
+void write_chrome_trace(FILE *out, const std::vector<std::string> &inputs,
+                        size_t numThreads) {
+  if (numThreads < 1) {
+    numThreads = 1;
+  }
+  if (numThreads > inputs.size()) {
+    numThreads = inputs.size();
+  }
+
+  const std::vector<ClockAlignment> clocks = read_clock_alignments(inputs);
+  const int64_t origin = shared_origin(clocks);
+
+  std::vector<std::unique_ptr<Stream>> streams;
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    streams.push_back(std::make_unique<Stream>(inputs[i], clocks[i], origin));
+  }
+
+  Pool pool(numThreads);
+  for (auto &s : streams) {
+    pool.schedule(s.get());
+  }
+
+  // k-way merge on the start time of each stream's current row, ties broken
+  // by input order
+  struct Cursor {
+    Batch batch;
+    size_t row = 0;
+  };
+  std::vector<Cursor> cursors(streams.size());
+  using Head = std::pair<int64_t, size_t>;
+  std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heap;
+  for (size_t i = 0; i < streams.size(); ++i) {
+    if (next_batch(pool, *streams[i], cursors[i].batch)) {
+      heap.emplace(cursors[i].batch.start[0], i);
+    }
+  }
+
+  std::fputs("{\"traceEvents\":[", out);
+  bool first = true;
+  while (!heap.empty()) {
+    const size_t i = heap.top().second;
+    heap.pop();
+    Cursor &c = cursors[i];
+
+    const uint32_t begin = c.row ? c.batch.stop[c.row - 1] : 0;
+    std::fputs(first ? "\n" : ",\n", out);
+    first = false;
+    std::fwrite(c.batch.text.data() + begin, 1, c.batch.stop[c.row] - begin,
+                out);
+
+    if (++c.row == c.batch.start.size()) {
+      c.row = 0;
+      if (!next_batch(pool, *streams[i], c.batch)) {
+        continue;
+      }
+    }
+    heap.emplace(c.batch.start[c.row], i);
+  }
+  std::fputs("\n],\"displayTimeUnit\":\"ms\","
+             "\"otherData\":{\"version\":\"kts chrome-tracing\"}}\n",
+             out);
+}
+
+} // namespace schema
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace schema {
+
+// Write the spans and events of the trace databases in inputs to out as one
+// chrome://tracing JSON document. Up to numThreads threads read and format the
+// inputs concurrently, and their streams are merged by start time.
+void write_chrome_trace(FILE *out, const std::vector<std::string> &inputs,
+                        size_t numThreads);
+
+} // namespace schema
@@ -0,0 +1,140 @@
+#include "kts_clock_alignment.hpp"
+
+#include <iostream>
+#include <limits>
+#include <map>
+
+#include "kts_schema.hpp"
+
+namespace schema {
+
+ClockAlignment::ClockAlignment(sqlite3 *db) {
+  // databases from before ClockOffsets have nothing to align with
+  sqlite3_stmt *stmt = prepare_query(
+      db, "SELECT COUNT(*) FROM sqlite_master WHERE name = 'ClockOffsets';");
+  const bool haveTable =
+      SQLITE_ROW == sqlite3_step(stmt) && sqlite3_column_int(stmt, 0) > 0;
+  sqlite3_finalize(stmt);
+  if (!haveTable) {
+    return;
+  }
+
+  // each rank's init and finalize, from one session
+  struct Points {
+    int inits = 0;
+    int finalizes = 0;
+    int64_t initTime = 0, initOffset = 0;
+    int64_t finalizeTime = 0, finalizeOffset = 0;
+  };
+  std::map<int, Points> points;
+  stmt = prepare_query(
+      db, "SELECT Rank, Point, Source, LocalTime, Offset FROM ClockOffsets;");
+  while (SQLITE_ROW == sqlite3_step(stmt)) {
+    const std::string source = column_text(stmt, 2);
+    if (source_.empty()) {
+      source_ = source;
+    } else if (source_ != source) {
+      source_ = "mixed";
+    }
+    Points &p = points[sqlite3_column_int(stmt, 0)];
+    const int64_t localTime = sqlite3_column_int64(stmt, 3);
+    const int64_t offset = sqlite3_column_int64(stmt, 4);
+    if (std::string(column_text(stmt, 1)) == "init") {
+      ++p.inits;
+      p.initTime = localTime;
+      p.initOffset = offset;
+    } else {
+      ++p.finalizes;
+      p.finalizeTime = localTime;
+      p.finalizeOffset = offset;
+    }
+  }
+  sqlite3_finalize(stmt);
+
+  for (const auto &kv : points) {
+    const Points &p = kv.second;
+    // Records do not say which session they are from, so there is no one
+    // line to put them on
+    if (p.inits != 1 || p.finalizes > 1) {
+      severalSessions_ = true;
+      fits_.clear();
+      return;
+    }
+    const int64_t dt = p.finalizeTime - p.initTime;
+    fits_[kv.first] = Fit{
+        p.initTime, p.initOffset,
+        p.finalizes && dt > 0 ? double(p.finalizeOffset - p.initOffset) /
+                                    double(dt)
+                              : 0};
+  }
+}
+
+int64_t ClockAlignment::origin() const {
+  int64_t origin = std::numeric_limits<int64_t>::max();
+  for (const auto &kv : fits_) {
+    const int64_t t = align(kv.first, 0);
+    origin = t < origin ? t : origin;
+  }
+  return fits_.empty() ? 0 : origin;
+}
+
+void ClockAlignment::merge(const ClockAlignment &other) {
+  if (other.empty()) {
+    return;
+  }
+  if (source_.empty()) {
+    source_ = other.source_;
+  } else if (source_ != other.source_) {
+    source_ = "mixed";
+  }
+  for (const auto &kv : other.fits_) {
+    fits_[kv.first] = kv.second;
+  }
+}
+
+std::vector<ClockAlignment>
+read_clock_alignments(const std::vector<std::string> &paths) {
+  std::vector<ClockAlignment> out;
+  ClockAlignment all;
+  size_t missing = 0;
+  for (const std::string &path : paths) {
+    sqlite3 *db = nullptr;
+    if (SQLITE_OK !=
+        sqlite3_open_v2(path.c_str(), &db, SQLITE_OPEN_READONLY, nullptr)) {
+      std::cerr << "Can't open database: " << sqlite3_errmsg(db) << std::endl;
+      exit(1);
+    }
+    out.emplace_back(db);
+    sqlite3_close(db);
+    if (out.back().several_sessions()) {
+      std::cerr << path << " has ClockOffsets from more than one session of "
+                   "a rank; leaving all times unaligned\n";
+      return std::vector<ClockAlignment>(paths.size());
+    }
+    missing += out.back().empty();
+    all.merge(out.back());
+  }
+  if (all.empty()) {
+    return out;
+  }
+  if (missing || all.source() == "mixed") {
+    std::cerr << "ranks' clocks were synchronized in different ways, or not "
+                 "at all; leaving their times unaligned\n";
+    return std::vector<ClockAlignment>(paths.size());
+  }
+  return out;
+}
+
+int64_t shared_origin(const std::vector<ClockAlignment> &alignments) {
+  int64_t origin = 0;
+  bool found = false;
+  for (const ClockAlignment &c : alignments) {
+    if (!c.empty() && (!found || c.origin() < origin)) {
+      origin = c.origin();
+      found = true;
+    }
+  }
+  return origin;
+}
+
+} // namespace schema
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <sqlite3.h>
+
+namespace schema {
+
+// Maps each rank's times onto the timeline its ClockOffsets share, a straight
+// line through the offsets measured at init and at finalize so clocks that
+// drift apart are followed too. Ranks without offsets keep their times, and so
+// do all ranks of a database with more than one session of a rank, e.g. two
+// runs merged, as its records cannot be told apart by session.
+class ClockAlignment {
+public:
+  ClockAlignment() = default;
+  // the ClockOffsets of db, if it has any
+  explicit ClockAlignment(sqlite3 *db);
+
+  bool empty() const { return fits_.empty(); }
+  // the offsets were from more than one session of some rank, and are unused
+  bool several_sessions() const { return severalSessions_; }
+  // "mpi" or "wall", "" if empty, "mixed" if the ranks disagree
+  const std::string &source() const { return source_; }
+
+  int64_t align(int rank, int64_t t) const {
+    auto it = fits_.find(rank);
+    if (it == fits_.end()) {
+      return t;
+    }
+    const Fit &f = it->second;
+    return t + f.offset + int64_t(double(t - f.localTime) * f.drift);
+  }
+
+  // the earliest init of any rank on the shared timeline
+  int64_t origin() const;
+
+  // the offsets of other too. Both must be of the same source
+  void merge(const ClockAlignment &other);
+
+private:
+  struct Fit {
+    int64_t localTime;
+    int64_t offset;
+    double drift; // offset change per ns
+  };
+  std::unordered_map<int, Fit> fits_;
+  std::string source_;
+  bool severalSessions_ = false;
+};
+
+// The alignments of the databases at paths. If they do not all share a
+// source, or one has several sessions of a rank, times from them are not
+// comparable, and they are all left empty with a warning on stderr
+std::vector<ClockAlignment>
+read_clock_alignments(const std::vector<std::string> &paths);
+
+// the earliest origin() of any of alignments, 0 if they are all empty
+int64_t shared_origin(const std::vector<ClockAlignment> &alignments);
+
+} // namespace schema
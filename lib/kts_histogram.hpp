@@ -0,0 +1,76 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+namespace schema {
+
+// A log-linear histogram of non-negative integers (durations in ns): values
+// below SUB get their own bucket, above that each power of two is split into
+// SUB buckets, so a bucket is never wider than 1/SUB of its lower bound.
+struct Histogram {
+  static constexpr int SUB_BITS = 2;
+  static constexpr uint64_t SUB = 1 << SUB_BITS;
+  static constexpr int NUM_BUCKETS = (64 - SUB_BITS) * SUB + SUB;
+
+  std::array<uint64_t, NUM_BUCKETS> counts{};
+
+  static int bucket(uint64_t v) {
+    if (v < SUB) {
+      return int(v);
+    }
+    const int msb = 63 - __builtin_clzll(v);
+    const int sub = int((v >> (msb - SUB_BITS)) & (SUB - 1));
+    return (msb - SUB_BITS + 1) * int(SUB) + sub;
+  }
+
+  // smallest value in bucket b
+  static uint64_t lower_bound(int b) {
+    if (b < int(SUB)) {
+      return uint64_t(b);
+    }
+    const int msb = b / int(SUB) + SUB_BITS - 1;
+    const uint64_t sub = uint64_t(b) % SUB;
+    return (uint64_t(1) << msb) | (sub << (msb - SUB_BITS));
+  }
+
+  // one past the largest value in bucket b
+  static uint64_t upper_bound(int b) {
+    if (b + 1 == NUM_BUCKETS) {
+      return UINT64_MAX;
+    }
+    return lower_bound(b + 1);
+  }
+
+  void add(uint64_t v, uint64_t n = 1) { counts[bucket(v)] += n; }
+
+  void merge(const Histogram &other) {
+    for (int b = 0; b < NUM_BUCKETS; ++b) {
+      counts[b] += other.counts[b];
+    }
+  }
+
+  // an estimate of the q-quantile (0 <= q <= 1): the midpoint of the bucket
+  // it falls in
+  uint64_t quantile(double q) const {
+    uint64_t total = 0;
+    for (uint64_t c : counts) {
+      total += c;
+    }
+    if (0 == total) {
+      return 0;
+    }
+    const uint64_t rank = uint64_t(q * double(total - 1)) + 1;
+    uint64_t seen = 0;
+    for (int b = 0; b < NUM_BUCKETS; ++b) {
+      seen += counts[b];
+      if (seen >= rank) {
+        const uint64_t lo = lower_bound(b);
+        return lo + (upper_bound(b) - 1 - lo) / 2;
+      }
+    }
+    return lower_bound(NUM_BUCKETS - 1);
+  }
+};
+
+} // namespace schema
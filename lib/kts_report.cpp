@@ -0,0 +1,92 @@
+#include "kts_report.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace schema {
+
+bool parse_report_options(int argc, char **argv,
+                          const std::vector<std::string> &sorts,
+                          void (*help)(std::ostream &), ReportOptions &options,
+                          int &status) {
+  options.sort = sorts.front();
+  for (int i = 1; i < argc; ++i) {
+    const bool hasValue = i + 1 < argc;
+    if (0 == std::strcmp(argv[i], "--sort") && hasValue) {
+      options.sort = argv[++i];
+    } else if (0 == std::strcmp(argv[i], "--top") && hasValue) {
+      options.top = std::strtoul(argv[++i], nullptr, 10);
+    } else if (0 == std::strcmp(argv[i], "--kind") && hasValue) {
+      options.kind = argv[++i];
+    } else if (0 == std::strcmp(argv[i], "--name") && hasValue) {
+      options.nameRegex = argv[++i];
+    } else if (0 == std::strcmp(argv[i], "--format") && hasValue) {
+      options.format = argv[++i];
+    } else if (0 == std::strcmp(argv[i], "-j") && hasValue) {
+      options.numThreads = std::strtoul(argv[++i], nullptr, 10);
+    } else if (0 == std::strcmp(argv[i], "-h") ||
+               0 == std::strcmp(argv[i], "--help")) {
+      help(std::cout);
+      status = 0;
+      return false;
+    } else {
+      options.inputs.push_back(argv[i]);
+    }
+  }
+
+  status = 1;
+  if (options.inputs.empty()) {
+    help(std::cerr);
+    return false;
+  }
+  if (options.format != "table" && options.format != "csv" &&
+      options.format != "json") {
+    std::cerr << "unknown format " << options.format << "\n";
+    return false;
+  }
+  if (std::find(sorts.begin(), sorts.end(), options.sort) == sorts.end()) {
+    std::cerr << "unknown sort " << options.sort << "\n";
+    return false;
+  }
+  if (!options.nameRegex.empty()) {
+    try {
+      options.name = std::regex(options.nameRegex);
+    } catch (const std::regex_error &e) {
+      std::cerr << "invalid --name regex: " << e.what() << "\n";
+      return false;
+    }
+  }
+  status = 0;
+  return true;
+}
+
+std::string json_string(const std::string &s) {
+  std::string out = "\"";
+  for (const char c : s) {
+    if (c == '"' || c == '\\') {
+      out += '\\';
+      out += c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char buf[8];
+      std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+      out += buf;
+    } else {
+      out += c;
+    }
+  }
+  return out + "\"";
+}
+
+std::string csv_string(const std::string &s) {
+  std::string out = "\"";
+  for (const char c : s) {
+    out += c;
+    if (c == '"') {
+      out += '"';
+    }
+  }
+  return out + "\"";
+}
+
+} // namespace schema
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <iostream>
+#include <regex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace schema {
+
+// The options kts-summary and kts-imbalance share: which rows to report, how
+// to order and format them, and how many threads read the inputs
+struct ReportOptions {
+  std::string sort;
+  std::string format = "table"; // table, csv or json
+  std::string kind;
+  std::string nameRegex;
+  std::regex name;
+  size_t top = 20; // 0 for all
+  size_t numThreads = std::thread::hardware_concurrency();
+  std::vector<std::string> inputs;
+
+  // the --kind and --name filters
+  bool matches(const std::string &k, const std::string &n) const {
+    return (kind.empty() || k == kind) &&
+           (nameRegex.empty() || std::regex_search(n, name));
+  }
+};
+
+// Parse --sort, --top, --kind, --name, --format and -j, and the input paths.
+// sorts are the --sort orders the tool takes, the first one the default.
+// Returns false if the tool should exit with status: after --help, or with a
+// message on stderr for a bad option
+bool parse_report_options(int argc, char **argv,
+                          const std::vector<std::string> &sorts,
+                          void (*help)(std::ostream &), ReportOptions &options,
+                          int &status);
+
+// s quoted for JSON, or for CSV
+std::string json_string(const std::string &s);
+std::string csv_string(const std::string &s);
+
+// Call read(result, i) for each input i on up to numThreads threads, each
+// reading into a Result of its own that takes the next unread input, and
+// return their merge
+template <typename Result, typename Read>
+Result read_in_parallel(size_t numInputs, size_t numThreads, Read &&read) {
+  numThreads = std::max<size_t>(1, std::min(numThreads, numInputs));
+  std::vector<Result> partial(numThreads);
+  std::atomic<size_t> next{0};
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < numThreads; ++t) {
+    threads.emplace_back([&, t]() {
+      for (size_t i = next++; i < numInputs; i = next++) {
+        read(partial[t], i);
+      }
+    });
+  }
+  for (std::thread &t : threads) {
+    t.join();
+  }
+  for (size_t t = 1; t < numThreads; ++t) {
+    partial[0].merge(partial[t]);
+  }
+  return std::move(partial[0]);
+}
+
+} // namespace schema
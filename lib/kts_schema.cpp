@@ -1,93 +1,528 @@
 #include "kts_schema.hpp"
 
+#include <string>
+
 namespace schema {
 
-sqlite3_stmt *Span::insert_stmt = nullptr;
-sqlite3_stmt *Event::insert_stmt = nullptr;
+sqlite3_stmt *Meta::insert_stmt = nullptr;
+sqlite3_stmt *Name::insert_stmt = nullptr;
+sqlite3_stmt *KindName::insert_stmt = nullptr;
+sqlite3_stmt *SpanRecord::insert_stmt = nullptr;
+sqlite3_stmt *EventRecord::insert_stmt = nullptr;
+sqlite3_stmt *DeepCopyRecord::insert_stmt = nullptr;
+sqlite3_stmt *RegionPath::insert_stmt = nullptr;
+sqlite3_stmt *KernelStat::insert_stmt = nullptr;
+sqlite3_stmt *KernelHistogramBucket::insert_stmt = nullptr;
+sqlite3_stmt *SampleCount::insert_stmt = nullptr;
+sqlite3_stmt *SectionStat::insert_stmt = nullptr;
+sqlite3_stmt *ClockOffset::insert_stmt = nullptr;
+sqlite3_stmt *RankSummary::insert_stmt = nullptr;
+sqlite3_stmt *KtsStat::insert_stmt = nullptr;
+sqlite3_stmt *MemorySpace::insert_stmt = nullptr;
+sqlite3_stmt *MemorySample::insert_stmt = nullptr;
+sqlite3_stmt *MemoryPeak::insert_stmt = nullptr;
+sqlite3_stmt *MemoryLeak::insert_stmt = nullptr;
 
-Span Span::from_sqlite_args(int argc, char **argv) {
-  if (argc != 6) {
-    throw std::runtime_error("unexpected argc");
+const char *kind_name(Kind kind) {
+  switch (kind) {
+  case Kind::PARFOR:
+    return "PARALLEL_FOR";
+  case Kind::PARRED:
+    return "PARALLEL_REDUCE";
+  case Kind::PARSCAN:
+    return "PARALLEL_SCAN";
+  case Kind::REGION:
+    return "REGION";
+  case Kind::DEEPCOPY:
+    return "DEEPCOPY";
+  case Kind::FENCE:
+    return "FENCE";
+  case Kind::ALLOC:
+    return "ALLOC";
+  case Kind::DEALLOC:
+    return "DEALLOC";
+  case Kind::EVENT:
+    return "EVENT";
+  case Kind::SECTION:
+    return "SECTION";
+  case Kind::NUM_KINDS:
+    break;
   }
-  return Span{std::atoi(argv[1]), argv[2], argv[3], std::atof(argv[4]),
-              std::atof(argv[5])};
+  return "UNKNOWN";
 }
 
-Event Event::from_sqlite_args(int argc, char **argv) {
-  if (argc != 5) {
-    throw std::runtime_error("unexpected argc");
+void create_tables(sqlite3 *db) {
+  for (const char *sql :
+       {Meta::create_table_sql, Name::create_table_sql,
+        KindName::create_table_sql, SpanRecord::create_table_sql,
+        EventRecord::create_table_sql, DeepCopyRecord::create_table_sql,
+        RegionPath::create_table_sql, RegionPathName::create_table_sql,
+        KernelStat::create_table_sql, KernelHistogramBucket::create_table_sql,
+        SampleCount::create_table_sql, SectionStat::create_table_sql,
+        ClockOffset::create_table_sql, RankSummary::create_table_sql,
+        KtsStat::create_table_sql,
+        MemorySpace::create_table_sql, MemorySample::create_table_sql,
+        MemoryPeak::create_table_sql, MemoryLeak::create_table_sql,
+        Span::create_table_sql, Event::create_table_sql,
+        DeepCopy::create_table_sql}) {
+    char *errMsg = 0;
+    int rc = sqlite3_exec(db, sql, 0, 0, &errMsg);
+    if (rc != SQLITE_OK) {
+      std::cerr << "SQL error: " << errMsg << std::endl;
+      sqlite3_free(errMsg);
+    }
   }
-  return Event{std::atoi(argv[1]), argv[2], argv[3], std::atof(argv[4])};
 }
 
-void init(sqlite3 *db) {
-
-  // prepare Span insertion statement
-  {
-    int rc =
-        sqlite3_prepare_v2(db, Span::insert_sql, -1, &Span::insert_stmt, 0);
+bool create_indexes(sqlite3 *db) {
+  bool ok = true;
+  for (const char *sql :
+       {SpanRecord::create_index_sql, SpanRecord::create_lookup_index_sql,
+        EventRecord::create_index_sql, EventRecord::create_lookup_index_sql,
+        SpanInterval::create_table_sql, SpanInterval::populate_sql}) {
+    char *errMsg = 0;
+    int rc = sqlite3_exec(db, sql, 0, 0, &errMsg);
     if (rc != SQLITE_OK) {
-      std::cerr << "Failed to prepare statement: " << sqlite3_errmsg(db)
-                << std::endl;
-      sqlite3_close(db);
-      exit(1);
+      std::cerr << "SQL error: " << errMsg << std::endl;
+      sqlite3_free(errMsg);
+      ok = false;
     }
   }
-  // prepare Event insertion statement
-  {
-    int rc =
-        sqlite3_prepare_v2(db, Event::insert_sql, -1, &Event::insert_stmt, 0);
-    if (rc != SQLITE_OK) {
-      std::cerr << "Failed to prepare statement: " << sqlite3_errmsg(db)
-                << std::endl;
-      sqlite3_close(db);
-      exit(1);
-    }
+  return ok;
+}
+
+static void prepare(sqlite3 *db, const char *sql, sqlite3_stmt **stmt) {
+  int rc = sqlite3_prepare_v2(db, sql, -1, stmt, 0);
+  if (rc != SQLITE_OK) {
+    std::cerr << "Failed to prepare statement: " << sqlite3_errmsg(db)
+              << std::endl;
+    sqlite3_close(db);
+    exit(1);
   }
 }
 
+static void bind_device(sqlite3_stmt *stmt, int i, int64_t device) {
+  if (device == NO_DEVICE) {
+    sqlite3_bind_null(stmt, i);
+  } else {
+    sqlite3_bind_int64(stmt, i, device);
+  }
+}
+
+static void bind_parent(sqlite3_stmt *stmt, int i, int64_t parentID) {
+  if (parentID == NO_PARENT) {
+    sqlite3_bind_null(stmt, i);
+  } else {
+    sqlite3_bind_int64(stmt, i, parentID);
+  }
+}
+
+sqlite3_stmt *prepare_query(sqlite3 *db, const char *sql) {
+  sqlite3_stmt *stmt = nullptr;
+  prepare(db, sql, &stmt);
+  return stmt;
+}
+
+const char *column_text(sqlite3_stmt *stmt, int i) {
+  const unsigned char *text = sqlite3_column_text(stmt, i);
+  return text ? reinterpret_cast<const char *>(text) : "";
+}
+
+void init(sqlite3 *db) {
+  prepare(db, Meta::insert_sql, &Meta::insert_stmt);
+  prepare(db, Name::insert_sql, &Name::insert_stmt);
+  prepare(db, KindName::insert_sql, &KindName::insert_stmt);
+  prepare(db, SpanRecord::insert_sql, &SpanRecord::insert_stmt);
+  prepare(db, EventRecord::insert_sql, &EventRecord::insert_stmt);
+  prepare(db, DeepCopyRecord::insert_sql, &DeepCopyRecord::insert_stmt);
+  prepare(db, RegionPath::insert_sql, &RegionPath::insert_stmt);
+  prepare(db, KernelStat::insert_sql, &KernelStat::insert_stmt);
+  prepare(db, KernelHistogramBucket::insert_sql,
+          &KernelHistogramBucket::insert_stmt);
+  prepare(db, SampleCount::insert_sql, &SampleCount::insert_stmt);
+  prepare(db, SectionStat::insert_sql, &SectionStat::insert_stmt);
+  prepare(db, ClockOffset::insert_sql, &ClockOffset::insert_stmt);
+  prepare(db, RankSummary::insert_sql, &RankSummary::insert_stmt);
+  prepare(db, KtsStat::insert_sql, &KtsStat::insert_stmt);
+  prepare(db, MemorySpace::insert_sql, &MemorySpace::insert_stmt);
+  prepare(db, MemorySample::insert_sql, &MemorySample::insert_stmt);
+  prepare(db, MemoryPeak::insert_sql, &MemoryPeak::insert_stmt);
+  prepare(db, MemoryLeak::insert_sql, &MemoryLeak::insert_stmt);
+}
+
 void finalize(sqlite3 *) {
-  sqlite3_finalize(Event::insert_stmt);
-  sqlite3_finalize(Span::insert_stmt);
+  sqlite3_finalize(MemoryLeak::insert_stmt);
+  sqlite3_finalize(MemoryPeak::insert_stmt);
+  sqlite3_finalize(MemorySample::insert_stmt);
+  sqlite3_finalize(MemorySpace::insert_stmt);
+  sqlite3_finalize(KtsStat::insert_stmt);
+  sqlite3_finalize(RankSummary::insert_stmt);
+  sqlite3_finalize(ClockOffset::insert_stmt);
+  sqlite3_finalize(SectionStat::insert_stmt);
+  sqlite3_finalize(SampleCount::insert_stmt);
+  sqlite3_finalize(KernelHistogramBucket::insert_stmt);
+  sqlite3_finalize(KernelStat::insert_stmt);
+  sqlite3_finalize(RegionPath::insert_stmt);
+  sqlite3_finalize(DeepCopyRecord::insert_stmt);
+  sqlite3_finalize(EventRecord::insert_stmt);
+  sqlite3_finalize(SpanRecord::insert_stmt);
+  sqlite3_finalize(KindName::insert_stmt);
+  sqlite3_finalize(Name::insert_stmt);
+  sqlite3_finalize(Meta::insert_stmt);
+}
+
+void insert(sqlite3 *db, const Meta &meta) {
+  sqlite3_bind_text(Meta::insert_stmt, 1, meta.key, -1, SQLITE_STATIC);
+  sqlite3_bind_text(Meta::insert_stmt, 2, meta.value, -1, SQLITE_STATIC);
+
+  int rc = sqlite3_step(Meta::insert_stmt);
+
+  if (rc != SQLITE_DONE) {
+    std::cerr << "Execution failed: " << sqlite3_errmsg(db) << std::endl;
+    std::cerr << "Meta was:"
+              << " " << meta.key << " " << meta.value << "\n";
+    exit(1);
+  }
+  sqlite3_reset(Meta::insert_stmt);
+}
+
+void insert(sqlite3 *db, const Name &name) {
+  sqlite3_bind_int64(Name::insert_stmt, 1, name.id);
+  sqlite3_bind_text(Name::insert_stmt, 2, name.name, -1, SQLITE_STATIC);
+
+  int rc = sqlite3_step(Name::insert_stmt);
+
+  if (rc != SQLITE_DONE) {
+    std::cerr << "Execution failed: " << sqlite3_errmsg(db) << std::endl;
+    std::cerr << "Name was:"
+              << " " << name.id << " " << name.name << "\n";
+    exit(1);
+  }
+  sqlite3_reset(Name::insert_stmt);
 }
 
-void insert(sqlite3 *db, const Span &span) {
-  sqlite3_bind_int(Span::insert_stmt, 1, span.rank);
-  sqlite3_bind_text(Span::insert_stmt, 2, span.name.c_str(), -1, SQLITE_STATIC);
-  sqlite3_bind_text(Span::insert_stmt, 3, span.kind.c_str(), -1, SQLITE_STATIC);
-  sqlite3_bind_double(Span::insert_stmt, 4, span.start);
-  sqlite3_bind_double(Span::insert_stmt, 5, span.stop);
+void insert(sqlite3 *db, const KindName &kind) {
+  sqlite3_bind_int(KindName::insert_stmt, 1, int(kind.kind));
+  sqlite3_bind_text(KindName::insert_stmt, 2, kind_name(kind.kind), -1,
+                    SQLITE_STATIC);
+
+  int rc = sqlite3_step(KindName::insert_stmt);
+
+  if (rc != SQLITE_DONE) {
+    std::cerr << "Execution failed: " << sqlite3_errmsg(db) << std::endl;
+    std::cerr << "Kind was:"
+              << " " << kind_name(kind.kind) << "\n";
+    exit(1);
+  }
+  sqlite3_reset(KindName::insert_stmt);
+}
 
-  int rc = sqlite3_step(Span::insert_stmt);
+void insert(sqlite3 *db, const SpanRecord &span) {
+  sqlite3_bind_int64(SpanRecord::insert_stmt, 1, span.id);
+  sqlite3_bind_int(SpanRecord::insert_stmt, 2, span.rank);
+  sqlite3_bind_int64(SpanRecord::insert_stmt, 3, span.tid);
+  sqlite3_bind_int64(SpanRecord::insert_stmt, 4, span.nameID);
+  sqlite3_bind_int(SpanRecord::insert_stmt, 5, int(span.kind));
+  bind_device(SpanRecord::insert_stmt, 6, span.device);
+  bind_parent(SpanRecord::insert_stmt, 7, span.parentID);
+  sqlite3_bind_int64(SpanRecord::insert_stmt, 8, span.depth);
+  sqlite3_bind_int64(SpanRecord::insert_stmt, 9, span.start);
+  sqlite3_bind_int64(SpanRecord::insert_stmt, 10, span.stop);
+
+  int rc = sqlite3_step(SpanRecord::insert_stmt);
 
   if (rc != SQLITE_DONE) {
     std::cerr << "Execution failed: " << sqlite3_errmsg(db) << std::endl;
     std::cerr << "Span was:"
-              << " " << span.name << " " << span.kind << " " << span.start
-              << " " << span.stop << "\n";
+              << " " << span.nameID << " " << kind_name(span.kind) << " "
+              << span.start << " " << span.stop << "\n";
+    exit(1);
+  }
+  sqlite3_reset(SpanRecord::insert_stmt);
+}
+
+void insert(sqlite3 *db, const EventRecord &event) {
+  sqlite3_bind_int(EventRecord::insert_stmt, 1, event.rank);
+  sqlite3_bind_int64(EventRecord::insert_stmt, 2, event.tid);
+  sqlite3_bind_int64(EventRecord::insert_stmt, 3, event.nameID);
+  sqlite3_bind_int(EventRecord::insert_stmt, 4, int(event.kind));
+  bind_device(EventRecord::insert_stmt, 5, event.device);
+  bind_parent(EventRecord::insert_stmt, 6, event.parentID);
+  sqlite3_bind_int64(EventRecord::insert_stmt, 7, event.depth);
+  sqlite3_bind_int64(EventRecord::insert_stmt, 8, event.time);
+
+  int rc = sqlite3_step(EventRecord::insert_stmt);
+
+  if (rc != SQLITE_DONE) {
+    std::cerr << "Execution failed: " << sqlite3_errmsg(db) << std::endl;
+    std::cerr << "Event was:"
+              << " " << event.nameID << " " << kind_name(event.kind) << " "
+              << event.time << "\n";
+    exit(1);
+  }
+  sqlite3_reset(EventRecord::insert_stmt);
+}
+
+void insert(sqlite3 *db, const DeepCopyRecord &copy) {
+  sqlite3_bind_int64(DeepCopyRecord::insert_stmt, 1, copy.id);
+  sqlite3_bind_int64(DeepCopyRecord::insert_stmt, 2, copy.srcSpaceID);
+  sqlite3_bind_int64(DeepCopyRecord::insert_stmt, 3, copy.srcNameID);
+  sqlite3_bind_int64(DeepCopyRecord::insert_stmt, 4, copy.dstSpaceID);
+  sqlite3_bind_int64(DeepCopyRecord::insert_stmt, 5, copy.dstNameID);
+  sqlite3_bind_int64(DeepCopyRecord::insert_stmt, 6, copy.bytes);
+
+  int rc = sqlite3_step(DeepCopyRecord::insert_stmt);
+
+  if (rc != SQLITE_DONE) {
+    std::cerr << "Execution failed: " << sqlite3_errmsg(db) << std::endl;
+    std::cerr << "Deep copy was:"
+              << " " << copy.id << " " << copy.bytes << "\n";
+    exit(1);
+  }
+  sqlite3_reset(DeepCopyRecord::insert_stmt);
+}
+
+void insert(sqlite3 *db, const RegionPath &path) {
+  sqlite3_bind_int64(RegionPath::insert_stmt, 1, path.id);
+  sqlite3_bind_int64(RegionPath::insert_stmt, 2, path.parentID);
+  sqlite3_bind_int64(RegionPath::insert_stmt, 3, path.nameID);
+
+  int rc = sqlite3_step(RegionPath::insert_stmt);
+
+  if (rc != SQLITE_DONE) {
+    std::cerr << "Execution failed: " << sqlite3_errmsg(db) << std::endl;
+    std::cerr << "RegionPath was:"
+              << " " << path.id << " " << path.parentID << " " << path.nameID
+              << "\n";
+    exit(1);
+  }
+  sqlite3_reset(RegionPath::insert_stmt);
+}
+
+void insert(sqlite3 *db, const KernelStat &stat) {
+  sqlite3_bind_int64(KernelStat::insert_stmt, 1, stat.id);
+  sqlite3_bind_int(KernelStat::insert_stmt, 2, stat.rank);
+  sqlite3_bind_int64(KernelStat::insert_stmt, 3, stat.nameID);
+  sqlite3_bind_int(KernelStat::insert_stmt, 4, int(stat.kind));
+  bind_device(KernelStat::insert_stmt, 5, stat.device);
+  sqlite3_bind_int64(KernelStat::insert_stmt, 6, stat.pathID);
+  sqlite3_bind_int64(KernelStat::insert_stmt, 7, stat.count);
+  sqlite3_bind_double(KernelStat::insert_stmt, 8, stat.total);
+  sqlite3_bind_double(KernelStat::insert_stmt, 9, stat.min);
+  sqlite3_bind_double(KernelStat::insert_stmt, 10, stat.max);
+  sqlite3_bind_double(KernelStat::insert_stmt, 11,
+                      stat.count ? stat.total / double(stat.count) : 0);
+
+  int rc = sqlite3_step(KernelStat::insert_stmt);
+
+  if (rc != SQLITE_DONE) {
+    std::cerr << "Execution failed: " << sqlite3_errmsg(db) << std::endl;
+    std::cerr << "KernelStat was:"
+              << " " << stat.nameID << " " << kind_name(stat.kind) << " "
+              << stat.count << " " << stat.total << "\n";
+    exit(1);
+  }
+  sqlite3_reset(KernelStat::insert_stmt);
+}
+
+void insert(sqlite3 *db, const KernelHistogramBucket &bucket) {
+  sqlite3_bind_int64(KernelHistogramBucket::insert_stmt, 1, bucket.statID);
+  sqlite3_bind_double(KernelHistogramBucket::insert_stmt, 2, bucket.lower);
+  sqlite3_bind_double(KernelHistogramBucket::insert_stmt, 3, bucket.upper);
+  sqlite3_bind_int64(KernelHistogramBucket::insert_stmt, 4, bucket.count);
+
+  int rc = sqlite3_step(KernelHistogramBucket::insert_stmt);
+
+  if (rc != SQLITE_DONE) {
+    std::cerr << "Execution failed: " << sqlite3_errmsg(db) << std::endl;
+    std::cerr << "KernelHistogramBucket was:"
+              << " " << bucket.statID << " " << bucket.lower << " "
+              << bucket.count << "\n";
+    exit(1);
+  }
+  sqlite3_reset(KernelHistogramBucket::insert_stmt);
+}
+
+void insert(sqlite3 *db, const SampleCount &count) {
+  sqlite3_bind_int(SampleCount::insert_stmt, 1, count.rank);
+  sqlite3_bind_int64(SampleCount::insert_stmt, 2, count.nameID);
+  sqlite3_bind_int64(SampleCount::insert_stmt, 3, count.seen);
+  sqlite3_bind_int64(SampleCount::insert_stmt, 4, count.recorded);
+
+  int rc = sqlite3_step(SampleCount::insert_stmt);
+
+  if (rc != SQLITE_DONE) {
+    std::cerr << "Execution failed: " << sqlite3_errmsg(db) << std::endl;
+    std::cerr << "SampleCount was:"
+              << " " << count.nameID << " " << count.seen << " "
+              << count.recorded << "\n";
     exit(1);
   }
-  sqlite3_reset(Span::insert_stmt);
+  sqlite3_reset(SampleCount::insert_stmt);
 }
 
-void insert(sqlite3 *db, const Event &event) {
-  sqlite3_bind_int(Event::insert_stmt, 1, event.rank);
-  sqlite3_bind_text(Event::insert_stmt, 2, event.name.c_str(), -1,
+void insert(sqlite3 *db, const SectionStat &stat) {
+  sqlite3_bind_int(SectionStat::insert_stmt, 1, stat.rank);
+  sqlite3_bind_int64(SectionStat::insert_stmt, 2, stat.nameID);
+  sqlite3_bind_int64(SectionStat::insert_stmt, 3, stat.count);
+  sqlite3_bind_double(SectionStat::insert_stmt, 4, stat.total);
+  sqlite3_bind_double(SectionStat::insert_stmt, 5, stat.min);
+  sqlite3_bind_double(SectionStat::insert_stmt, 6, stat.max);
+  sqlite3_bind_double(SectionStat::insert_stmt, 7,
+                      stat.count ? stat.total / double(stat.count) : 0);
+
+  int rc = sqlite3_step(SectionStat::insert_stmt);
+
+  if (rc != SQLITE_DONE) {
+    std::cerr << "Execution failed: " << sqlite3_errmsg(db) << std::endl;
+    std::cerr << "SectionStat was:"
+              << " " << stat.nameID << " " << stat.count << " " << stat.total
+              << "\n";
+    exit(1);
+  }
+  sqlite3_reset(SectionStat::insert_stmt);
+}
+
+void insert(sqlite3 *db, const ClockOffset &offset) {
+  sqlite3_bind_int(ClockOffset::insert_stmt, 1, offset.rank);
+  sqlite3_bind_text(ClockOffset::insert_stmt, 2, offset.point, -1,
                     SQLITE_STATIC);
-  sqlite3_bind_text(Event::insert_stmt, 3, event.kind.c_str(), -1,
+  sqlite3_bind_text(ClockOffset::insert_stmt, 3, offset.source, -1,
                     SQLITE_STATIC);
-  sqlite3_bind_double(Event::insert_stmt, 4, event.time);
+  sqlite3_bind_int64(ClockOffset::insert_stmt, 4, offset.localTime);
+  sqlite3_bind_int64(ClockOffset::insert_stmt, 5, offset.offset);
+  sqlite3_bind_int64(ClockOffset::insert_stmt, 6, offset.error);
 
-  int rc = sqlite3_step(Event::insert_stmt);
+  int rc = sqlite3_step(ClockOffset::insert_stmt);
 
   if (rc != SQLITE_DONE) {
     std::cerr << "Execution failed: " << sqlite3_errmsg(db) << std::endl;
-    std::cerr << "Event was:"
-              << " " << event.name << " " << event.kind << " " << event.time
+    std::cerr << "ClockOffset was:"
+              << " " << offset.point << " " << offset.source << " "
+              << offset.localTime << " " << offset.offset << "\n";
+    exit(1);
+  }
+  sqlite3_reset(ClockOffset::insert_stmt);
+}
+
+void insert(sqlite3 *db, const RankSummary &summary) {
+  sqlite3_bind_int64(RankSummary::insert_stmt, 1, summary.nameID);
+  sqlite3_bind_int(RankSummary::insert_stmt, 2, int(summary.kind));
+  sqlite3_bind_int64(RankSummary::insert_stmt, 3, summary.ranks);
+  sqlite3_bind_int64(RankSummary::insert_stmt, 4, summary.count);
+  sqlite3_bind_double(RankSummary::insert_stmt, 5, summary.total);
+  sqlite3_bind_double(RankSummary::insert_stmt, 6, summary.min);
+  sqlite3_bind_double(RankSummary::insert_stmt, 7, summary.max);
+  sqlite3_bind_double(RankSummary::insert_stmt, 8, summary.minRankTotal);
+  sqlite3_bind_double(RankSummary::insert_stmt, 9, summary.maxRankTotal);
+  sqlite3_bind_double(RankSummary::insert_stmt, 10,
+                      summary.ranks ? summary.total / double(summary.ranks)
+                                    : 0);
+  sqlite3_bind_int64(RankSummary::insert_stmt, 11, summary.maxRank);
+
+  int rc = sqlite3_step(RankSummary::insert_stmt);
+
+  if (rc != SQLITE_DONE) {
+    std::cerr << "Execution failed: " << sqlite3_errmsg(db) << std::endl;
+    std::cerr << "RankSummary was:"
+              << " " << summary.nameID << " " << kind_name(summary.kind) << " "
+              << summary.ranks << " " << summary.total << "\n";
+    exit(1);
+  }
+  sqlite3_reset(RankSummary::insert_stmt);
+}
+
+void insert(sqlite3 *db, const KtsStat &stat) {
+  sqlite3_bind_int(KtsStat::insert_stmt, 1, stat.rank);
+  sqlite3_bind_text(KtsStat::insert_stmt, 2, stat.name, -1, SQLITE_STATIC);
+  sqlite3_bind_double(KtsStat::insert_stmt, 3, stat.value);
+
+  int rc = sqlite3_step(KtsStat::insert_stmt);
+
+  if (rc != SQLITE_DONE) {
+    std::cerr << "Execution failed: " << sqlite3_errmsg(db) << std::endl;
+    std::cerr << "KtsStat was:"
+              << " " << stat.name << " " << stat.value << "\n";
+    exit(1);
+  }
+  sqlite3_reset(KtsStat::insert_stmt);
+}
+
+void insert(sqlite3 *db, const MemorySpace &space) {
+  sqlite3_bind_int(MemorySpace::insert_stmt, 1, space.rank);
+  sqlite3_bind_int64(MemorySpace::insert_stmt, 2, space.spaceID);
+  sqlite3_bind_int64(MemorySpace::insert_stmt, 3, space.peakBytes);
+  sqlite3_bind_int64(MemorySpace::insert_stmt, 4, space.peakTime);
+  sqlite3_bind_int64(MemorySpace::insert_stmt, 5, space.finalBytes);
+  sqlite3_bind_int64(MemorySpace::insert_stmt, 6, space.allocations);
+  sqlite3_bind_int64(MemorySpace::insert_stmt, 7, space.deallocations);
+
+  int rc = sqlite3_step(MemorySpace::insert_stmt);
+
+  if (rc != SQLITE_DONE) {
+    std::cerr << "Execution failed: " << sqlite3_errmsg(db) << std::endl;
+    std::cerr << "MemorySpace was:"
+              << " " << space.spaceID << " " << space.peakBytes << "\n";
+    exit(1);
+  }
+  sqlite3_reset(MemorySpace::insert_stmt);
+}
+
+void insert(sqlite3 *db, const MemorySample &sample) {
+  sqlite3_bind_int(MemorySample::insert_stmt, 1, sample.rank);
+  sqlite3_bind_int64(MemorySample::insert_stmt, 2, sample.spaceID);
+  sqlite3_bind_int64(MemorySample::insert_stmt, 3, sample.time);
+  sqlite3_bind_int64(MemorySample::insert_stmt, 4, sample.bytes);
+  sqlite3_bind_int64(MemorySample::insert_stmt, 5, sample.maxBytes);
+
+  int rc = sqlite3_step(MemorySample::insert_stmt);
+
+  if (rc != SQLITE_DONE) {
+    std::cerr << "Execution failed: " << sqlite3_errmsg(db) << std::endl;
+    std::cerr << "MemorySample was:"
+              << " " << sample.spaceID << " " << sample.time << " "
+              << sample.bytes << "\n";
+    exit(1);
+  }
+  sqlite3_reset(MemorySample::insert_stmt);
+}
+
+void insert(sqlite3 *db, const MemoryPeak &peak) {
+  sqlite3_bind_int(MemoryPeak::insert_stmt, 1, peak.rank);
+  sqlite3_bind_int64(MemoryPeak::insert_stmt, 2, peak.spaceID);
+  sqlite3_bind_int64(MemoryPeak::insert_stmt, 3, peak.nameID);
+  sqlite3_bind_int64(MemoryPeak::insert_stmt, 4, peak.count);
+  sqlite3_bind_int64(MemoryPeak::insert_stmt, 5, peak.bytes);
+
+  int rc = sqlite3_step(MemoryPeak::insert_stmt);
+
+  if (rc != SQLITE_DONE) {
+    std::cerr << "Execution failed: " << sqlite3_errmsg(db) << std::endl;
+    std::cerr << "MemoryPeak was:"
+              << " " << peak.spaceID << " " << peak.nameID << " " << peak.bytes
               << "\n";
     exit(1);
   }
-  sqlite3_reset(Event::insert_stmt);
+  sqlite3_reset(MemoryPeak::insert_stmt);
+}
+
+void insert(sqlite3 *db, const MemoryLeak &leak) {
+  sqlite3_bind_int(MemoryLeak::insert_stmt, 1, leak.rank);
+  sqlite3_bind_int64(MemoryLeak::insert_stmt, 2, leak.spaceID);
+  sqlite3_bind_int64(MemoryLeak::insert_stmt, 3, leak.nameID);
+  sqlite3_bind_int64(MemoryLeak::insert_stmt, 4, leak.address);
+  sqlite3_bind_int64(MemoryLeak::insert_stmt, 5, leak.bytes);
+  sqlite3_bind_int64(MemoryLeak::insert_stmt, 6, leak.time);
+
+  int rc = sqlite3_step(MemoryLeak::insert_stmt);
+
+  if (rc != SQLITE_DONE) {
+    std::cerr << "Execution failed: " << sqlite3_errmsg(db) << std::endl;
+    std::cerr << "MemoryLeak was:"
+              << " " << leak.nameID << " " << leak.bytes << "\n";
+    exit(1);
+  }
+  sqlite3_reset(MemoryLeak::insert_stmt);
 }
 
-} // namespace schema
\ No newline at end of file
+} // namespace schema
@@ -1,94 +1,620 @@
 #pragma once
 
-#include <functional>
+#include <cstdint>
 #include <iostream>
 #include <string>
 
 #include <sqlite3.h>
 
 namespace schema {
-struct Event {
+
+// bumped whenever the layout of the tables below changes
+constexpr int VERSION = 13;
+
+// what a span or event records. Stored in the Kinds table by value
+enum class Kind : uint8_t {
+  PARFOR,
+  PARRED,
+  PARSCAN,
+  REGION,
+  DEEPCOPY,
+  FENCE,
+  ALLOC,
+  DEALLOC,
+  EVENT,
+  SECTION,
+  NUM_KINDS
+};
+
+const char *kind_name(Kind kind);
+
+// Device column value for kinds that do not run on a device
+constexpr int64_t NO_DEVICE = -1;
+
+// ParentID column value for spans and events outside of any region
+constexpr int64_t NO_PARENT = -1;
+
+struct Meta {
+  static constexpr const char *create_table_sql =
+      "CREATE TABLE IF NOT EXISTS Meta("
+      "Key TEXT PRIMARY KEY,"
+      "Value TEXT NOT NULL);";
+  static constexpr const char *insert_sql =
+      "INSERT OR REPLACE INTO Meta (Key, Value) VALUES (?, ?);";
+  static sqlite3_stmt *insert_stmt;
+
+  const char *key;
+  const char *value;
+};
+
+struct Name {
+  static constexpr const char *create_table_sql =
+      "CREATE TABLE IF NOT EXISTS Names("
+      "ID INTEGER PRIMARY KEY,"
+      "Name TEXT NOT NULL);";
+  static constexpr const char *insert_sql =
+      "INSERT OR REPLACE INTO Names (ID, Name) VALUES (?, ?);";
+  static sqlite3_stmt *insert_stmt;
+
+  int64_t id;
+  const char *name;
+};
+
+struct KindName {
+  static constexpr const char *create_table_sql =
+      "CREATE TABLE IF NOT EXISTS Kinds("
+      "ID INTEGER PRIMARY KEY,"
+      "Name TEXT NOT NULL UNIQUE);";
+  static constexpr const char *insert_sql =
+      "INSERT OR REPLACE INTO Kinds (ID, Name) VALUES (?, ?);";
+  static sqlite3_stmt *insert_stmt;
+
+  Kind kind;
+};
+
+struct SpanRecord {
   static constexpr const char *create_table_sql =
-      "CREATE TABLE IF NOT EXISTS Events("
-      "ID INTEGER PRIMARY KEY AUTOINCREMENT,"
+      "CREATE TABLE IF NOT EXISTS SpanRecords("
+      "ID INTEGER PRIMARY KEY,"
       "Rank INTEGER NOT NULL,"
-      "Name TEXT NOT NULL,"
-      "Kind TEXT NOT NULL,"
-      "Time REAL NOT NULL);";
+      "Tid INTEGER NOT NULL,"
+      "NameID INTEGER NOT NULL REFERENCES Names(ID),"
+      "KindID INTEGER NOT NULL REFERENCES Kinds(ID),"
+      "Device INTEGER,"
+      "ParentID INTEGER,"
+      "Depth INTEGER NOT NULL,"
+      "Start INTEGER NOT NULL,"
+      "Stop INTEGER NOT NULL);";
+  static constexpr const char *create_index_sql =
+      "CREATE INDEX IF NOT EXISTS SpanRecordsStart ON SpanRecords(Start);";
+  static constexpr const char *create_lookup_index_sql =
+      "CREATE INDEX IF NOT EXISTS SpanRecordsKind ON SpanRecords(KindID);"
+      "CREATE INDEX IF NOT EXISTS SpanRecordsName ON SpanRecords(NameID);"
+      "CREATE INDEX IF NOT EXISTS SpanRecordsParent ON SpanRecords(ParentID);";
   static constexpr const char *insert_sql =
-      "INSERT INTO Events (Rank, Name, Kind, Time) VALUES (?, ?, ?, ?);";
+      "INSERT INTO SpanRecords (ID, Rank, Tid, NameID, KindID, Device, "
+      "ParentID, Depth, Start, Stop) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?);";
   static sqlite3_stmt *insert_stmt;
 
+  int64_t id;
   int rank;
-  std::string name;
-  std::string kind;
-  double time;
+  int64_t tid;
+  int64_t nameID;
+  Kind kind;
+  int64_t device;   // NO_DEVICE stores NULL
+  int64_t parentID; // NO_PARENT stores NULL
+  int64_t depth;
+  int64_t start; // ns since init
+  int64_t stop;
+};
 
-  static Event from_sqlite_args(int argc, char **argv);
+struct EventRecord {
+  static constexpr const char *create_table_sql =
+      "CREATE TABLE IF NOT EXISTS EventRecords("
+      "ID INTEGER PRIMARY KEY,"
+      "Rank INTEGER NOT NULL,"
+      "Tid INTEGER NOT NULL,"
+      "NameID INTEGER NOT NULL REFERENCES Names(ID),"
+      "KindID INTEGER NOT NULL REFERENCES Kinds(ID),"
+      "Device INTEGER,"
+      "ParentID INTEGER,"
+      "Depth INTEGER NOT NULL,"
+      "Time INTEGER NOT NULL);";
+  static constexpr const char *create_index_sql =
+      "CREATE INDEX IF NOT EXISTS EventRecordsTime ON EventRecords(Time);";
+  static constexpr const char *create_lookup_index_sql =
+      "CREATE INDEX IF NOT EXISTS EventRecordsKind ON EventRecords(KindID);"
+      "CREATE INDEX IF NOT EXISTS EventRecordsName ON EventRecords(NameID);"
+      "CREATE INDEX IF NOT EXISTS EventRecordsParent ON "
+      "EventRecords(ParentID);";
+  static constexpr const char *insert_sql =
+      "INSERT INTO EventRecords (Rank, Tid, NameID, KindID, Device, ParentID, "
+      "Depth, Time) VALUES (?, ?, ?, ?, ?, ?, ?, ?);";
+  static sqlite3_stmt *insert_stmt;
+
+  int rank;
+  int64_t tid;
+  int64_t nameID;
+  Kind kind;
+  int64_t device;   // NO_DEVICE stores NULL
+  int64_t parentID; // NO_PARENT stores NULL
+  int64_t depth;
+  int64_t time; // ns since init
 };
 
-struct Span {
+// what each DEEPCOPY span copied: the SpanRecords row with the same ID
+struct DeepCopyRecord {
+  static constexpr const char *create_table_sql =
+      "CREATE TABLE IF NOT EXISTS DeepCopyRecords("
+      "ID INTEGER PRIMARY KEY REFERENCES SpanRecords(ID),"
+      "SrcSpaceID INTEGER NOT NULL REFERENCES Names(ID),"
+      "SrcNameID INTEGER NOT NULL REFERENCES Names(ID),"
+      "DstSpaceID INTEGER NOT NULL REFERENCES Names(ID),"
+      "DstNameID INTEGER NOT NULL REFERENCES Names(ID),"
+      "Bytes INTEGER NOT NULL);";
+  static constexpr const char *insert_sql =
+      "INSERT INTO DeepCopyRecords (ID, SrcSpaceID, SrcNameID, DstSpaceID, "
+      "DstNameID, Bytes) VALUES (?, ?, ?, ?, ?, ?);";
+  static sqlite3_stmt *insert_stmt;
+
+  int64_t id;
+  int64_t srcSpaceID;
+  int64_t srcNameID;
+  int64_t dstSpaceID;
+  int64_t dstNameID;
+  int64_t bytes;
+};
+
+// An R*Tree over the [Start, Stop] interval of each SpanRecords row, with the
+// same ID. Built by create_indexes. Bounds are 32-bit floats rounded outward,
+// so compare against SpanRecords for exact containment
+struct SpanInterval {
+  static constexpr const char *create_table_sql =
+      "CREATE VIRTUAL TABLE IF NOT EXISTS SpanIntervals "
+      "USING rtree(ID, Start, Stop);";
+  static constexpr const char *populate_sql =
+      "INSERT OR REPLACE INTO SpanIntervals SELECT ID, Start, Stop "
+      "FROM SpanRecords;";
+};
+
+// a stack of nested regions: the region NameID inside the path ParentID.
+// Path 0 is outside of any region and has no row
+struct RegionPath {
+  static constexpr const char *create_table_sql =
+      "CREATE TABLE IF NOT EXISTS RegionPaths("
+      "ID INTEGER PRIMARY KEY,"
+      "ParentID INTEGER NOT NULL,"
+      "NameID INTEGER NOT NULL REFERENCES Names(ID));";
+  static constexpr const char *insert_sql =
+      "INSERT OR REPLACE INTO RegionPaths (ID, ParentID, NameID) "
+      "VALUES (?, ?, ?);";
+  static sqlite3_stmt *insert_stmt;
+
+  int64_t id;
+  int64_t parentID;
+  int64_t nameID;
+};
+
+// RegionPaths spelled out as "outer/inner"
+struct RegionPathName {
+  static constexpr const char *create_table_sql =
+      "CREATE VIEW IF NOT EXISTS RegionPathNames AS "
+      "WITH RECURSIVE p(ID, Path) AS ("
+      "SELECT 0, '' "
+      "UNION ALL "
+      "SELECT r.ID, CASE WHEN p.ID = 0 THEN n.Name "
+      "ELSE p.Path || '/' || n.Name END "
+      "FROM RegionPaths r "
+      "JOIN p ON r.ParentID = p.ID "
+      "JOIN Names n ON n.ID = r.NameID) "
+      "SELECT ID, Path FROM p;";
+};
+
+// per (name, kind, device, enclosing region path) statistics, written at
+// finalize when KTS_MODE=aggregate. Times are in seconds
+struct KernelStat {
+  static constexpr const char *create_table_sql =
+      "CREATE TABLE IF NOT EXISTS KernelStats("
+      "ID INTEGER PRIMARY KEY,"
+      "Rank INTEGER NOT NULL,"
+      "NameID INTEGER NOT NULL REFERENCES Names(ID),"
+      "KindID INTEGER NOT NULL REFERENCES Kinds(ID),"
+      "Device INTEGER,"
+      "PathID INTEGER NOT NULL,"
+      "Count INTEGER NOT NULL,"
+      "Total REAL NOT NULL,"
+      "Min REAL NOT NULL,"
+      "Max REAL NOT NULL,"
+      "Mean REAL NOT NULL);";
+  static constexpr const char *insert_sql =
+      "INSERT INTO KernelStats (ID, Rank, NameID, KindID, Device, PathID, "
+      "Count, Total, Min, Max, Mean) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?);";
+  static sqlite3_stmt *insert_stmt;
+
+  int64_t id;
+  int rank;
+  int64_t nameID;
+  Kind kind;
+  int64_t device; // NO_DEVICE stores NULL
+  int64_t pathID;
+  int64_t count;
+  double total;
+  double min;
+  double max;
+};
+
+// the non-empty buckets of each KernelStats row's duration histogram.
+// A bucket holds durations in [Lower, Upper) seconds
+struct KernelHistogramBucket {
+  static constexpr const char *create_table_sql =
+      "CREATE TABLE IF NOT EXISTS KernelHistograms("
+      "StatID INTEGER NOT NULL REFERENCES KernelStats(ID),"
+      "Lower REAL NOT NULL,"
+      "Upper REAL NOT NULL,"
+      "Count INTEGER NOT NULL);";
+  static constexpr const char *insert_sql =
+      "INSERT INTO KernelHistograms (StatID, Lower, Upper, Count) "
+      "VALUES (?, ?, ?, ?);";
+  static sqlite3_stmt *insert_stmt;
+
+  int64_t statID;
+  double lower;
+  double upper;
+  int64_t count;
+};
+
+// how many launches of each kernel were seen and how many were recorded, when
+// KTS_SAMPLE_EVERY or KTS_INCLUDE / KTS_EXCLUDE are set
+struct SampleCount {
+  static constexpr const char *create_table_sql =
+      "CREATE TABLE IF NOT EXISTS Sampling("
+      "Rank INTEGER NOT NULL,"
+      "NameID INTEGER NOT NULL REFERENCES Names(ID),"
+      "Seen INTEGER NOT NULL,"
+      "Recorded INTEGER NOT NULL);";
+  static constexpr const char *insert_sql =
+      "INSERT INTO Sampling (Rank, NameID, Seen, Recorded) "
+      "VALUES (?, ?, ?, ?);";
+  static sqlite3_stmt *insert_stmt;
+
+  int rank;
+  int64_t nameID;
+  int64_t seen;
+  int64_t recorded;
+};
+
+// per profile section name statistics, written at finalize. Times are in
+// seconds
+struct SectionStat {
+  static constexpr const char *create_table_sql =
+      "CREATE TABLE IF NOT EXISTS Sections("
+      "Rank INTEGER NOT NULL,"
+      "NameID INTEGER NOT NULL REFERENCES Names(ID),"
+      "Count INTEGER NOT NULL,"
+      "Total REAL NOT NULL,"
+      "Min REAL NOT NULL,"
+      "Max REAL NOT NULL,"
+      "Mean REAL NOT NULL);";
+  static constexpr const char *insert_sql =
+      "INSERT INTO Sections (Rank, NameID, Count, Total, Min, Max, Mean) "
+      "VALUES (?, ?, ?, ?, ?, ?, ?);";
+  static sqlite3_stmt *insert_stmt;
+
+  int rank;
+  int64_t nameID;
+  int64_t count;
+  double total;
+  double min;
+  double max;
+};
+
+// A rank's clock against a timeline shared by all ranks, measured at init and
+// at finalize: a time t on this rank near localTime is t + offset on the shared
+// timeline. Times are in ns
+struct ClockOffset {
+  static constexpr const char *create_table_sql =
+      "CREATE TABLE IF NOT EXISTS ClockOffsets("
+      "Rank INTEGER NOT NULL,"
+      "Point TEXT NOT NULL,"
+      "Source TEXT NOT NULL,"
+      "LocalTime INTEGER NOT NULL,"
+      "Offset INTEGER NOT NULL,"
+      "Error INTEGER NOT NULL);";
+  static constexpr const char *insert_sql =
+      "INSERT INTO ClockOffsets (Rank, Point, Source, LocalTime, Offset, "
+      "Error) VALUES (?, ?, ?, ?, ?, ?);";
+  static sqlite3_stmt *insert_stmt;
+
+  int rank;
+  const char *point;  // "init" or "finalize"
+  const char *source; // "mpi": rank 0's times, "wall": the Unix epoch
+  int64_t localTime;
+  int64_t offset;
+  int64_t error; // bound on the error of offset, 0 if not known
+};
+
+// per (name, kind) statistics across MPI ranks, written by rank 0 to the
+// summary database when KTS_MPI_SUMMARY is set. Times are in seconds
+struct RankSummary {
+  static constexpr const char *create_table_sql =
+      "CREATE TABLE IF NOT EXISTS RankSummaries("
+      "NameID INTEGER NOT NULL REFERENCES Names(ID),"
+      "KindID INTEGER NOT NULL REFERENCES Kinds(ID),"
+      "Ranks INTEGER NOT NULL,"
+      "Count INTEGER NOT NULL,"
+      "Total REAL NOT NULL,"
+      "Min REAL NOT NULL,"
+      "Max REAL NOT NULL,"
+      "MinRankTotal REAL NOT NULL,"
+      "MaxRankTotal REAL NOT NULL,"
+      "MeanRankTotal REAL NOT NULL,"
+      "MaxRank INTEGER NOT NULL);";
+  static constexpr const char *insert_sql =
+      "INSERT INTO RankSummaries (NameID, KindID, Ranks, Count, Total, Min, "
+      "Max, MinRankTotal, MaxRankTotal, MeanRankTotal, MaxRank) "
+      "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?);";
+  static sqlite3_stmt *insert_stmt;
+
+  int64_t nameID;
+  Kind kind;
+  int64_t ranks; // that recorded this name and kind
+  int64_t count;
+  double total;
+  double min; // the shortest single one on any rank
+  double max;
+  double minRankTotal; // of the ranks that recorded it
+  double maxRankTotal;
+  int64_t maxRank; // the rank with maxRankTotal
+};
+
+// counters describing the tool itself, written at finalize
+struct KtsStat {
   static constexpr const char *create_table_sql =
-      "CREATE TABLE IF NOT EXISTS Spans("
-      "ID INTEGER PRIMARY KEY AUTOINCREMENT,"
+      "CREATE TABLE IF NOT EXISTS KtsStats("
       "Rank INTEGER NOT NULL,"
       "Name TEXT NOT NULL,"
-      "Kind TEXT NOT NULL,"
-      "Start REAL NOT NULL,"
-      "Stop REAL NOT NULL);";
+      "Value NUMERIC NOT NULL);";
+  static constexpr const char *insert_sql =
+      "INSERT INTO KtsStats (Rank, Name, Value) VALUES (?, ?, ?);";
+  static sqlite3_stmt *insert_stmt;
+
+  int rank;
+  const char *name;
+  double value;
+};
+
+// current and peak bytes allocated in each memory space, written at finalize
+struct MemorySpace {
+  static constexpr const char *create_table_sql =
+      "CREATE TABLE IF NOT EXISTS MemorySpaces("
+      "Rank INTEGER NOT NULL,"
+      "SpaceID INTEGER NOT NULL REFERENCES Names(ID),"
+      "PeakBytes INTEGER NOT NULL,"
+      "PeakTime INTEGER NOT NULL,"
+      "FinalBytes INTEGER NOT NULL,"
+      "Allocations INTEGER NOT NULL,"
+      "Deallocations INTEGER NOT NULL);";
+  static constexpr const char *insert_sql =
+      "INSERT INTO MemorySpaces (Rank, SpaceID, PeakBytes, PeakTime, "
+      "FinalBytes, Allocations, Deallocations) VALUES (?, ?, ?, ?, ?, ?, ?);";
+  static sqlite3_stmt *insert_stmt;
+
+  int rank;
+  int64_t spaceID;
+  int64_t peakBytes;
+  int64_t peakTime; // ns since init
+  int64_t finalBytes;
+  int64_t allocations;
+  int64_t deallocations;
+};
+
+// bytes allocated in a memory space over time, downsampled
+struct MemorySample {
+  static constexpr const char *create_table_sql =
+      "CREATE TABLE IF NOT EXISTS MemoryTimeline("
+      "Rank INTEGER NOT NULL,"
+      "SpaceID INTEGER NOT NULL REFERENCES Names(ID),"
+      "Time INTEGER NOT NULL,"
+      "Bytes INTEGER NOT NULL,"
+      "MaxBytes INTEGER NOT NULL);";
+  static constexpr const char *insert_sql =
+      "INSERT INTO MemoryTimeline (Rank, SpaceID, Time, Bytes, MaxBytes) "
+      "VALUES (?, ?, ?, ?, ?);";
+  static sqlite3_stmt *insert_stmt;
+
+  int rank;
+  int64_t spaceID;
+  int64_t time; // ns since init
+  int64_t bytes;
+  int64_t maxBytes;
+};
+
+// the allocations alive at the peak of a memory space, by name
+struct MemoryPeak {
+  static constexpr const char *create_table_sql =
+      "CREATE TABLE IF NOT EXISTS MemoryPeaks("
+      "Rank INTEGER NOT NULL,"
+      "SpaceID INTEGER NOT NULL REFERENCES Names(ID),"
+      "NameID INTEGER NOT NULL REFERENCES Names(ID),"
+      "Count INTEGER NOT NULL,"
+      "Bytes INTEGER NOT NULL);";
   static constexpr const char *insert_sql =
-      "INSERT INTO Spans (Rank, Name, Kind, Start, Stop) VALUES (?, ?, ?, ?, "
-      "?);";
+      "INSERT INTO MemoryPeaks (Rank, SpaceID, NameID, Count, Bytes) "
+      "VALUES (?, ?, ?, ?, ?);";
   static sqlite3_stmt *insert_stmt;
 
   int rank;
+  int64_t spaceID;
+  int64_t nameID;
+  int64_t count;
+  int64_t bytes;
+};
+
+// allocations that were never freed
+struct MemoryLeak {
+  static constexpr const char *create_table_sql =
+      "CREATE TABLE IF NOT EXISTS MemoryLeaks("
+      "Rank INTEGER NOT NULL,"
+      "SpaceID INTEGER NOT NULL REFERENCES Names(ID),"
+      "NameID INTEGER NOT NULL REFERENCES Names(ID),"
+      "Address INTEGER NOT NULL,"
+      "Bytes INTEGER NOT NULL,"
+      "Time INTEGER NOT NULL);";
+  static constexpr const char *insert_sql =
+      "INSERT INTO MemoryLeaks (Rank, SpaceID, NameID, Address, Bytes, Time) "
+      "VALUES (?, ?, ?, ?, ?, ?);";
+  static sqlite3_stmt *insert_stmt;
+
+  int rank;
+  int64_t spaceID;
+  int64_t nameID;
+  int64_t address;
+  int64_t bytes;
+  int64_t time; // ns since init, when it was allocated
+};
+
+// The original de-normalized shape, as a view over EventRecords
+struct Event {
+  static constexpr const char *create_table_sql =
+      "CREATE VIEW IF NOT EXISTS Events AS SELECT "
+      "e.ID AS ID,"
+      "e.Rank AS Rank,"
+      "e.Tid AS Tid,"
+      "n.Name AS Name,"
+      "k.Name || IFNULL('[' || e.Device || ']', '') AS Kind,"
+      "e.ParentID AS ParentID,"
+      "e.Depth AS Depth,"
+      "e.Time * 1e-9 AS Time "
+      "FROM EventRecords e "
+      "JOIN Names n ON n.ID = e.NameID "
+      "JOIN Kinds k ON k.ID = e.KindID;";
+
+  int rank;
+  int64_t tid;
+  std::string name;
+  std::string kind;
+  double time;
+};
+
+// The original de-normalized shape, as a view over SpanRecords
+struct Span {
+  static constexpr const char *create_table_sql =
+      "CREATE VIEW IF NOT EXISTS Spans AS SELECT "
+      "s.ID AS ID,"
+      "s.Rank AS Rank,"
+      "s.Tid AS Tid,"
+      "n.Name AS Name,"
+      "k.Name || IFNULL('[' || s.Device || ']', '') AS Kind,"
+      "s.ParentID AS ParentID,"
+      "s.Depth AS Depth,"
+      "s.Start * 1e-9 AS Start,"
+      "s.Stop * 1e-9 AS Stop "
+      "FROM SpanRecords s "
+      "JOIN Names n ON n.ID = s.NameID "
+      "JOIN Kinds k ON k.ID = s.KindID;";
+
+  int rank;
+  int64_t tid;
   std::string name;
   std::string kind;
   double start;
   double stop;
+};
 
-  static Span from_sqlite_args(int argc, char **argv);
+// DeepCopyRecords with names, times in seconds and bandwidth in bytes per
+// second. Bandwidth is NULL for copies too short for the timer to see
+struct DeepCopy {
+  static constexpr const char *create_table_sql =
+      "CREATE VIEW IF NOT EXISTS DeepCopies AS SELECT "
+      "s.ID AS ID,"
+      "s.Rank AS Rank,"
+      "s.Tid AS Tid,"
+      "ss.Name AS SrcSpace,"
+      "sn.Name AS Src,"
+      "ds.Name AS DstSpace,"
+      "dn.Name AS Dst,"
+      "c.Bytes AS Bytes,"
+      "s.Start * 1e-9 AS Start,"
+      "s.Stop * 1e-9 AS Stop,"
+      "c.Bytes * 1e9 / NULLIF(s.Stop - s.Start, 0) AS Bandwidth "
+      "FROM DeepCopyRecords c "
+      "JOIN SpanRecords s ON s.ID = c.ID "
+      "JOIN Names ss ON ss.ID = c.SrcSpaceID "
+      "JOIN Names sn ON sn.ID = c.SrcNameID "
+      "JOIN Names ds ON ds.ID = c.DstSpaceID "
+      "JOIN Names dn ON dn.ID = c.DstNameID;";
 };
 
+// create every table and view, in dependency order
+void create_tables(sqlite3 *db);
+
+// Create the lookup indexes and fill SpanIntervals. Meant to run once after
+// all records are written, so inserts during the run stay cheap. Returns false
+// if any of it failed
+bool create_indexes(sqlite3 *db);
+
 void init(sqlite3 *db);
 void finalize(sqlite3 *db);
-void insert(sqlite3 *db, const Span &span);
-void insert(sqlite3 *db, const Event &event);
+void insert(sqlite3 *db, const Meta &meta);
+void insert(sqlite3 *db, const Name &name);
+void insert(sqlite3 *db, const KindName &kind);
+void insert(sqlite3 *db, const SpanRecord &span);
+void insert(sqlite3 *db, const EventRecord &event);
+void insert(sqlite3 *db, const DeepCopyRecord &copy);
+void insert(sqlite3 *db, const RegionPath &path);
+void insert(sqlite3 *db, const KernelStat &stat);
+void insert(sqlite3 *db, const KernelHistogramBucket &bucket);
+void insert(sqlite3 *db, const SampleCount &count);
+void insert(sqlite3 *db, const SectionStat &stat);
+void insert(sqlite3 *db, const ClockOffset &offset);
+void insert(sqlite3 *db, const RankSummary &summary);
+void insert(sqlite3 *db, const KtsStat &stat);
+void insert(sqlite3 *db, const MemorySpace &space);
+void insert(sqlite3 *db, const MemorySample &sample);
+void insert(sqlite3 *db, const MemoryPeak &peak);
+void insert(sqlite3 *db, const MemoryLeak &leak);
+
+// prepare sql on db, exiting on failure
+sqlite3_stmt *prepare_query(sqlite3 *db, const char *sql);
 
-using SpanCallback = std::function<int(const Span &span)>;
-using EventCallback = std::function<int(const Event &event)>;
+// column i of the current row as text, "" for NULL
+const char *column_text(sqlite3_stmt *stmt, int i);
 
+// call c(const Span &) on each row of the Spans view, until c returns non-zero
 template <typename Callback> void for_all_spans(sqlite3 *db, Callback &&c) {
-  auto callback = [](void *data, int argc, char **argv,
-                     char **azColName) -> int {
-    auto f = static_cast<SpanCallback *>(data);
-    return (*f)(Span::from_sqlite_args(argc, argv));
-  };
-
-  // wrap in an std::function to pass in to userdata
-  SpanCallback wrapped(c);
-
-  char *errMsg;
-  if (sqlite3_exec(db, "SELECT * FROM Spans;", callback, &wrapped, &errMsg)) {
-    std::cerr << "Can't exec: " << errMsg << std::endl;
-    exit(1);
+  sqlite3_stmt *stmt = prepare_query(
+      db, "SELECT Rank, Tid, Name, Kind, Start, Stop FROM Spans;");
+  Span span;
+  while (SQLITE_ROW == sqlite3_step(stmt)) {
+    span.rank = sqlite3_column_int(stmt, 0);
+    span.tid = sqlite3_column_int64(stmt, 1);
+    span.name = column_text(stmt, 2);
+    span.kind = column_text(stmt, 3);
+    span.start = sqlite3_column_double(stmt, 4);
+    span.stop = sqlite3_column_double(stmt, 5);
+    if (c(span)) {
+      break;
+    }
   }
+  sqlite3_finalize(stmt);
 }
 
+// call c(const Event &) on each row of the Events view, until c returns
+// non-zero
 template <typename Callback> void for_all_events(sqlite3 *db, Callback &&c) {
-  auto callback = [](void *data, int argc, char **argv,
-                     char **azColName) -> int {
-    auto f = static_cast<EventCallback *>(data);
-    return (*f)(Event::from_sqlite_args(argc, argv));
-  };
-
-  // wrap in an std::function to pass in to userdata
-  EventCallback wrapped(c);
-
-  char *errMsg;
-  if (sqlite3_exec(db, "SELECT * FROM Events;", callback, &wrapped, &errMsg)) {
-    std::cerr << "Can't exec: " << errMsg << std::endl;
-    exit(1);
+  sqlite3_stmt *stmt =
+      prepare_query(db, "SELECT Rank, Tid, Name, Kind, Time FROM Events;");
+  Event event;
+  while (SQLITE_ROW == sqlite3_step(stmt)) {
+    event.rank = sqlite3_column_int(stmt, 0);
+    event.tid = sqlite3_column_int64(stmt, 1);
+    event.name = column_text(stmt, 2);
+    event.kind = column_text(stmt, 3);
+    event.time = sqlite3_column_double(stmt, 4);
+    if (c(event)) {
+      break;
+    }
   }
+  sqlite3_finalize(stmt);
 }
 } // namespace schema
@@ -0,0 +1,318 @@
+#include "kts_trace_log.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace schema {
+
+// what an entry is, in the low two bits of its first byte. The kind of a
+// record is in the rest
+enum : uint8_t { TAG_NAME, TAG_SPAN, TAG_EVENT, TAG_COPY };
+
+// each block starts with its used payload bytes and four bytes of padding
+static constexpr size_t BLOCK_HEADER_BYTES = 8;
+static constexpr size_t BLOCK_PAYLOAD_BYTES =
+    LOG_BLOCK_BYTES - BLOCK_HEADER_BYTES;
+// the file is mapped this many blocks at a time
+static constexpr size_t WINDOW_BLOCKS = 64;
+// enough for the largest record
+static constexpr size_t MAX_RECORD_BYTES = 1 + 15 * 10;
+
+static size_t put_varint(uint8_t *p, uint64_t v) {
+  size_t n = 0;
+  while (v >= 0x80) {
+    p[n++] = uint8_t(v) | 0x80;
+    v >>= 7;
+  }
+  p[n++] = uint8_t(v);
+  return n;
+}
+
+// small magnitudes of either sign to small unsigned numbers
+static uint64_t zigzag(int64_t v) {
+  return (uint64_t(v) << 1) ^ uint64_t(v >> 63);
+}
+
+static int64_t unzigzag(uint64_t v) {
+  return int64_t(v >> 1) ^ -int64_t(v & 1);
+}
+
+LogWriter::LogWriter(const std::string &path, int rank) : path_(path) {
+  fd_ = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd_ < 0) {
+    std::cerr << "Can't open log " << path << ": " << std::strerror(errno)
+              << std::endl;
+    exit(1);
+  }
+  map_window(0);
+
+  uint8_t *h = map_;
+  const uint32_t headerBytes = LOG_HEADER_BYTES;
+  const uint32_t blockBytes = LOG_BLOCK_BYTES;
+  std::memcpy(h, LOG_MAGIC, sizeof(LOG_MAGIC));
+  std::memcpy(h + 8, &LOG_VERSION, 4);
+  std::memcpy(h + 12, &rank, 4);
+  std::memcpy(h + 16, &headerBytes, 4);
+  std::memcpy(h + 20, &blockBytes, 4);
+
+  blockOffset_ = LOG_HEADER_BYTES;
+  block_ = map_ + blockOffset_;
+}
+
+LogWriter::~LogWriter() {
+  munmap(map_, mapBytes_);
+  if (0 != ftruncate(fd_, off_t(bytes()))) {
+    std::cerr << "Can't trim log " << path_ << ": " << std::strerror(errno)
+              << std::endl;
+  }
+  close(fd_);
+}
+
+// map WINDOW_BLOCKS blocks from offset, growing the file to cover them
+void LogWriter::map_window(uint64_t offset) {
+  if (map_) {
+    munmap(map_, mapBytes_);
+  }
+  const uint64_t page = uint64_t(sysconf(_SC_PAGESIZE));
+  mapOffset_ = offset / page * page;
+  mapBytes_ = size_t(offset - mapOffset_) + WINDOW_BLOCKS * LOG_BLOCK_BYTES;
+  if (0 != ftruncate(fd_, off_t(mapOffset_ + mapBytes_))) {
+    std::cerr << "Can't grow log " << path_ << ": " << std::strerror(errno)
+              << std::endl;
+    exit(1);
+  }
+  void *p = mmap(nullptr, mapBytes_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_,
+                 off_t(mapOffset_));
+  if (MAP_FAILED == p) {
+    std::cerr << "Can't map log " << path_ << ": " << std::strerror(errno)
+              << std::endl;
+    exit(1);
+  }
+  map_ = static_cast<uint8_t *>(p);
+}
+
+void LogWriter::next_block() {
+  blockOffset_ += LOG_BLOCK_BYTES;
+  if (blockOffset_ + LOG_BLOCK_BYTES > mapOffset_ + mapBytes_) {
+    map_window(blockOffset_);
+  }
+  block_ = map_ + (blockOffset_ - mapOffset_);
+  used_ = 0;
+  prevStart_ = 0;
+  prevID_ = 0;
+}
+
+// the caller has made sure n bytes fit
+void LogWriter::append(const uint8_t *p, size_t n) {
+  std::memcpy(block_ + BLOCK_HEADER_BYTES + used_, p, n);
+  used_ += uint32_t(n);
+  std::memcpy(block_, &used_, sizeof(used_));
+}
+
+void LogWriter::add_name(int64_t id, const char *name) {
+  uint8_t head[21];
+  size_t len = std::strlen(name);
+  size_t n = 0;
+  head[n++] = TAG_NAME;
+  n += put_varint(head + n, uint64_t(id));
+  const size_t room = BLOCK_PAYLOAD_BYTES - n - 10;
+  len = std::min(len, room);
+  n += put_varint(head + n, len);
+  if (used_ + n + len > BLOCK_PAYLOAD_BYTES) {
+    next_block();
+  }
+  // one entry, so the used bytes cover all of it or none of it
+  uint8_t *p = block_ + BLOCK_HEADER_BYTES + used_;
+  std::memcpy(p, head, n);
+  std::memcpy(p + n, name, len);
+  used_ += uint32_t(n + len);
+  std::memcpy(block_, &used_, sizeof(used_));
+}
+
+void LogWriter::add(const LogRecord &r) {
+  uint8_t buf[MAX_RECORD_BYTES];
+  auto encode = [&]() {
+    size_t n = 0;
+    const uint8_t tag = r.type == LogRecord::Type::SPAN    ? TAG_SPAN
+                        : r.type == LogRecord::Type::EVENT ? TAG_EVENT
+                                                           : TAG_COPY;
+    buf[n++] = uint8_t(tag | (uint8_t(r.kind) << 2));
+    n += put_varint(buf + n, uint64_t(r.tid));
+    n += put_varint(buf + n, zigzag(r.start - prevStart_));
+    if (r.type != LogRecord::Type::EVENT) {
+      n += put_varint(buf + n, zigzag(r.stop - r.start));
+      n += put_varint(buf + n, zigzag(r.id - prevID_));
+    }
+    n += put_varint(buf + n, uint64_t(r.nameID));
+    n += put_varint(buf + n, uint64_t(r.device + 1)); // NO_DEVICE is 0
+    // parents are recent spans, so close to the last ID
+    const int64_t id = r.type == LogRecord::Type::EVENT ? prevID_ : r.id;
+    n += put_varint(buf + n, r.parentID == NO_PARENT
+                                 ? 0
+                                 : 1 + zigzag(id - r.parentID));
+    n += put_varint(buf + n, uint64_t(r.depth));
+    if (r.type == LogRecord::Type::COPY) {
+      n += put_varint(buf + n, uint64_t(r.srcSpaceID));
+      n += put_varint(buf + n, uint64_t(r.srcNameID));
+      n += put_varint(buf + n, uint64_t(r.dstSpaceID));
+      n += put_varint(buf + n, uint64_t(r.dstNameID));
+      n += put_varint(buf + n, uint64_t(r.bytes));
+    }
+    return n;
+  };
+  size_t n = encode();
+  if (used_ + n > BLOCK_PAYLOAD_BYTES) {
+    // deltas start over in the new block
+    next_block();
+    n = encode();
+  }
+  append(buf, n);
+  prevStart_ = r.start;
+  if (r.type != LogRecord::Type::EVENT) {
+    prevID_ = r.id;
+  }
+}
+
+LogReader::LogReader(const std::string &path) : path_(path) {
+  const int fd = open(path.c_str(), O_RDONLY);
+  struct stat st;
+  if (fd < 0 || 0 != fstat(fd, &st)) {
+    std::cerr << "Can't open log " << path << ": " << std::strerror(errno)
+              << std::endl;
+    exit(1);
+  }
+  size_ = size_t(st.st_size);
+  if (size_ >= LOG_HEADER_BYTES) {
+    void *p = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (MAP_FAILED == p) {
+      std::cerr << "Can't map log " << path << ": " << std::strerror(errno)
+                << std::endl;
+      exit(1);
+    }
+    data_ = static_cast<const uint8_t *>(p);
+  }
+  close(fd);
+
+  uint32_t version = 0;
+  if (data_) {
+    std::memcpy(&version, data_ + 8, 4);
+  }
+  if (!data_ || 0 != std::memcmp(data_, LOG_MAGIC, sizeof(LOG_MAGIC)) ||
+      version != LOG_VERSION) {
+    std::cerr << path << " is not a version " << LOG_VERSION << " KTS log\n";
+    exit(1);
+  }
+  uint32_t headerBytes, blockBytes;
+  std::memcpy(&rank_, data_ + 12, 4);
+  std::memcpy(&headerBytes, data_ + 16, 4);
+  std::memcpy(&blockBytes, data_ + 20, 4);
+  if (blockBytes != LOG_BLOCK_BYTES) {
+    std::cerr << path << ": unexpected block size " << blockBytes << "\n";
+    exit(1);
+  }
+  blockOffset_ = headerBytes;
+  p_ = end_ = nullptr;
+}
+
+LogReader::~LogReader() {
+  if (data_) {
+    munmap(const_cast<uint8_t *>(data_), size_);
+  }
+}
+
+// move to the block at blockOffset_. Returns false if there is none, or it is
+// empty
+bool LogReader::next_block() {
+  if (blockOffset_ + BLOCK_HEADER_BYTES > size_) {
+    return false;
+  }
+  uint32_t used;
+  std::memcpy(&used, data_ + blockOffset_, sizeof(used));
+  p_ = data_ + blockOffset_ + BLOCK_HEADER_BYTES;
+  end_ = p_ + std::min<size_t>(used, size_ - (p_ - data_));
+  blockOffset_ += LOG_BLOCK_BYTES;
+  prevStart_ = 0;
+  prevID_ = 0;
+  return used > 0;
+}
+
+bool LogReader::next(LogEntry &entry) {
+  if (p_ == end_ && !next_block()) {
+    return false;
+  }
+  bool ok = true;
+  auto varint = [&]() -> uint64_t {
+    uint64_t v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      if (p_ == end_) {
+        ok = false;
+        return 0;
+      }
+      const uint8_t b = *p_++;
+      v |= uint64_t(b & 0x7f) << shift;
+      if (!(b & 0x80)) {
+        return v;
+      }
+    }
+    ok = false;
+    return v;
+  };
+
+  const uint8_t tag = *p_++;
+  entry.isName = (tag & 3) == TAG_NAME;
+  if (entry.isName) {
+    entry.nameID = int64_t(varint());
+    const uint64_t len = varint();
+    if (!ok || len > uint64_t(end_ - p_)) {
+      std::cerr << path_ << ": cut short in a name\n";
+      return false;
+    }
+    entry.name.assign(reinterpret_cast<const char *>(p_), size_t(len));
+    p_ += len;
+    return true;
+  }
+
+  LogRecord &r = entry.record;
+  r.type = (tag & 3) == TAG_SPAN    ? LogRecord::Type::SPAN
+           : (tag & 3) == TAG_EVENT ? LogRecord::Type::EVENT
+                                    : LogRecord::Type::COPY;
+  r.kind = Kind(tag >> 2);
+  r.tid = int64_t(varint());
+  r.start = prevStart_ + unzigzag(varint());
+  r.stop = r.start;
+  if (r.type != LogRecord::Type::EVENT) {
+    r.stop = r.start + unzigzag(varint());
+    r.id = prevID_ + unzigzag(varint());
+  }
+  r.nameID = int64_t(varint());
+  r.device = int64_t(varint()) - 1;
+  const uint64_t parent = varint();
+  const int64_t id = r.type == LogRecord::Type::EVENT ? prevID_ : r.id;
+  r.parentID = 0 == parent ? NO_PARENT : id - unzigzag(parent - 1);
+  r.depth = int64_t(varint());
+  if (r.type == LogRecord::Type::COPY) {
+    r.srcSpaceID = int64_t(varint());
+    r.srcNameID = int64_t(varint());
+    r.dstSpaceID = int64_t(varint());
+    r.dstNameID = int64_t(varint());
+    r.bytes = int64_t(varint());
+  }
+  if (!ok) {
+    std::cerr << path_ << ": cut short in a record\n";
+    return false;
+  }
+  prevStart_ = r.start;
+  if (r.type != LogRecord::Type::EVENT) {
+    prevID_ = r.id;
+  }
+  return true;
+}
+
+} // namespace schema
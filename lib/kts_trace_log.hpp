@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "kts_schema.hpp"
+
+namespace schema {
+
+// A binary alternative to the SpanRecords, EventRecords, DeepCopyRecords and
+// Names rows of one rank (KTS_OUTPUT=log), converted to them afterwards by
+// kts-convert.
+//
+// The file is a LOG_HEADER_BYTES header and then blocks of LOG_BLOCK_BYTES,
+// written through a memory map. Each block starts with the number of payload
+// bytes in use, and its entries are delta encoded from the start of the block
+// in LEB128 varints, so every block decodes on its own. The bytes in use are
+// updated after each entry is complete, and the map is shared with the page
+// cache, so the log of a process that was killed ends at its last whole entry.
+// A name is logged before the first entry that uses it.
+
+constexpr char LOG_MAGIC[8] = {'K', 'T', 'S', 'L', 'O', 'G', '\0', '\0'};
+constexpr uint32_t LOG_VERSION = 1;
+constexpr size_t LOG_HEADER_BYTES = 64;
+constexpr size_t LOG_BLOCK_BYTES = size_t(64) << 10;
+
+// one span, event or deep copy. Fields are as in the record tables
+struct LogRecord {
+  enum class Type : uint8_t { SPAN, EVENT, COPY };
+
+  Type type;
+  Kind kind;
+  int64_t tid;
+  int64_t id; // spans and copies only
+  int64_t nameID;
+  int64_t device;   // NO_DEVICE if none
+  int64_t parentID; // NO_PARENT if none
+  int64_t depth;
+  int64_t start; // for events, the event time
+  int64_t stop;
+  // copies only
+  int64_t srcSpaceID;
+  int64_t srcNameID;
+  int64_t dstSpaceID;
+  int64_t dstNameID;
+  int64_t bytes;
+};
+
+// appends to a new log at path, exiting on failure. Only one thread may use it
+class LogWriter {
+public:
+  LogWriter(const std::string &path, int rank);
+  // trims the file to the entries written
+  ~LogWriter();
+
+  LogWriter(const LogWriter &) = delete;
+  LogWriter &operator=(const LogWriter &) = delete;
+
+  // Names longer than a block holds are cut short
+  void add_name(int64_t id, const char *name);
+  void add(const LogRecord &record);
+
+  // file size once trimmed
+  uint64_t bytes() const { return blockOffset_ + 8 + used_; }
+
+private:
+  void append(const uint8_t *p, size_t n);
+  void next_block();
+  void map_window(uint64_t offset);
+
+  std::string path_;
+  int fd_ = -1;
+  uint8_t *map_ = nullptr;  // the mapped window of the file
+  uint64_t mapOffset_ = 0;  // where in the file it starts
+  size_t mapBytes_ = 0;
+  uint8_t *block_ = nullptr; // the block being filled
+  uint64_t blockOffset_ = 0;
+  uint32_t used_ = 0;        // payload bytes in it
+  int64_t prevStart_ = 0;
+  int64_t prevID_ = 0;
+};
+
+// one entry of a log: a name, or a record
+struct LogEntry {
+  bool isName;
+  int64_t nameID;
+  std::string name;
+  LogRecord record;
+};
+
+// reads a log written by LogWriter front to back, exiting if it is not one
+class LogReader {
+public:
+  explicit LogReader(const std::string &path);
+  ~LogReader();
+
+  LogReader(const LogReader &) = delete;
+  LogReader &operator=(const LogReader &) = delete;
+
+  int rank() const { return rank_; }
+
+  // Returns false after the last entry
+  bool next(LogEntry &entry);
+
+private:
+  bool next_block();
+
+  std::string path_;
+  const uint8_t *data_ = nullptr;
+  size_t size_ = 0;
+  int rank_ = 0;
+  size_t blockOffset_ = 0;
+  const uint8_t *p_ = nullptr; // the next entry in the current block
+  const uint8_t *end_ = nullptr;
+  int64_t prevStart_ = 0;
+  int64_t prevID_ = 0;
+};
+
+} // namespace schema
@@ -0,0 +1,142 @@
+#include "kts_trace_reader.hpp"
+
+#include <iostream>
+
+#include "kts_schema.hpp"
+
+namespace schema {
+
+static void prepare(sqlite3 *db, const char *sql, sqlite3_stmt **stmt) {
+  if (SQLITE_OK != sqlite3_prepare_v2(db, sql, -1, stmt, 0)) {
+    std::cerr << "Failed to prepare statement: " << sqlite3_errmsg(db)
+              << std::endl;
+    exit(1);
+  }
+}
+
+static const std::string UNKNOWN = "<unknown>";
+
+std::vector<std::string> read_dictionary(sqlite3 *db, const char *sql) {
+  std::vector<std::string> out;
+  sqlite3_stmt *stmt = prepare_query(db, sql);
+  while (SQLITE_ROW == sqlite3_step(stmt)) {
+    const int64_t id = sqlite3_column_int64(stmt, 0);
+    if (id < 0) {
+      continue;
+    }
+    if (size_t(id) >= out.size()) {
+      out.resize(id + 1, UNKNOWN);
+    }
+    out[id] = column_text(stmt, 1);
+  }
+  sqlite3_finalize(stmt);
+  return out;
+}
+
+const std::string &lookup(const std::vector<std::string> &dict, int64_t id) {
+  return (id >= 0 && size_t(id) < dict.size()) ? dict[id] : UNKNOWN;
+}
+
+static int64_t column_device(sqlite3_stmt *stmt, int i) {
+  if (SQLITE_NULL == sqlite3_column_type(stmt, i)) {
+    return NO_DEVICE;
+  }
+  return sqlite3_column_int64(stmt, i);
+}
+
+TraceReader::TraceReader(const std::string &path) : path_(path) {
+  if (SQLITE_OK !=
+      sqlite3_open_v2(path.c_str(), &db_, SQLITE_OPEN_READONLY, nullptr)) {
+    std::cerr << "Can't open database: " << sqlite3_errmsg(db_) << std::endl;
+    exit(1);
+  }
+
+  names_ = read_dictionary(db_, "SELECT ID, Name FROM Names;");
+  kinds_ = read_dictionary(db_, "SELECT ID, Name FROM Kinds;");
+
+  prepare(db_,
+          "SELECT Rank, Tid, NameID, KindID, Device, Start, Stop "
+          "FROM SpanRecords ORDER BY Start;",
+          &spans_);
+  prepare(db_,
+          "SELECT Rank, Tid, NameID, KindID, Device, Time "
+          "FROM EventRecords ORDER BY Time;",
+          &events_);
+  haveSpan_ = step_span();
+  haveEvent_ = step_event();
+}
+
+TraceReader::~TraceReader() {
+  sqlite3_finalize(spans_);
+  sqlite3_finalize(events_);
+  sqlite3_close(db_);
+}
+
+bool TraceReader::step_span() {
+  const int rc = sqlite3_step(spans_);
+  if (rc == SQLITE_DONE) {
+    return false;
+  } else if (rc != SQLITE_ROW) {
+    std::cerr << path_ << ": " << sqlite3_errmsg(db_) << std::endl;
+    exit(1);
+  }
+  span_ = TraceRow{TraceRow::Type::SPAN,
+                   sqlite3_column_int(spans_, 0),
+                   sqlite3_column_int64(spans_, 1),
+                   sqlite3_column_int64(spans_, 2),
+                   sqlite3_column_int64(spans_, 3),
+                   column_device(spans_, 4),
+                   sqlite3_column_int64(spans_, 5),
+                   sqlite3_column_int64(spans_, 6)};
+  return true;
+}
+
+bool TraceReader::step_event() {
+  const int rc = sqlite3_step(events_);
+  if (rc == SQLITE_DONE) {
+    return false;
+  } else if (rc != SQLITE_ROW) {
+    std::cerr << path_ << ": " << sqlite3_errmsg(db_) << std::endl;
+    exit(1);
+  }
+  const int64_t time = sqlite3_column_int64(events_, 5);
+  event_ = TraceRow{TraceRow::Type::EVENT,
+                    sqlite3_column_int(events_, 0),
+                    sqlite3_column_int64(events_, 1),
+                    sqlite3_column_int64(events_, 2),
+                    sqlite3_column_int64(events_, 3),
+                    column_device(events_, 4),
+                    time,
+                    time};
+  return true;
+}
+
+bool TraceReader::next(TraceRow &row) {
+  if (haveSpan_ && (!haveEvent_ || span_.start <= event_.start)) {
+    row = span_;
+    haveSpan_ = step_span();
+    return true;
+  } else if (haveEvent_) {
+    row = event_;
+    haveEvent_ = step_event();
+    return true;
+  }
+  return false;
+}
+
+const std::string &TraceReader::name(int64_t nameID) const {
+  return lookup(names_, nameID);
+}
+
+const std::string &TraceReader::kind(int64_t kindID) const {
+  return lookup(kinds_, kindID);
+}
+
+std::string TraceReader::kind_string(const TraceRow &row) const {
+  if (row.device == NO_DEVICE) {
+    return kind(row.kindID);
+  }
+  return kind(row.kindID) + "[" + std::to_string(row.device) + "]";
+}
+
+} // namespace schema
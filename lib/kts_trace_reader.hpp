@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <sqlite3.h>
+
+namespace schema {
+
+// An ID -> text dictionary table, e.g. "SELECT ID, Name FROM Names;", indexed
+// by ID. IDs missing from the table read "<unknown>"
+std::vector<std::string> read_dictionary(sqlite3 *db, const char *sql);
+// dict[id], or "<unknown>" if there is no such ID
+const std::string &lookup(const std::vector<std::string> &dict, int64_t id);
+
+// one span or event from SpanRecords / EventRecords
+struct TraceRow {
+  enum class Type : uint8_t { SPAN, EVENT };
+
+  Type type;
+  int rank;
+  int64_t tid;
+  int64_t nameID;
+  int64_t kindID;
+  int64_t device; // NO_DEVICE if NULL
+  int64_t start;  // ns. For events, the event time
+  int64_t stop;
+};
+
+// Streams the spans and events of one trace database in order of start time,
+// holding only the current row of each table in memory. The database is opened
+// read-only, so streaming in order without sorting needs the time indexes that
+// KTS_INDEX=1 builds at finalize. Without them SQLite sorts each whole table
+// before the first row comes back.
+class TraceReader {
+public:
+  explicit TraceReader(const std::string &path);
+  ~TraceReader();
+
+  TraceReader(const TraceReader &) = delete;
+  TraceReader &operator=(const TraceReader &) = delete;
+
+  // the next row by start time. Returns false when both tables are exhausted
+  bool next(TraceRow &row);
+
+  const std::string &name(int64_t nameID) const;
+  const std::string &kind(int64_t kindID) const;
+
+  // "PARALLEL_FOR[0]" style kind, as in the Spans view
+  std::string kind_string(const TraceRow &row) const;
+
+private:
+  bool step_span();
+  bool step_event();
+
+  std::string path_;
+  sqlite3 *db_ = nullptr;
+  sqlite3_stmt *spans_ = nullptr;
+  sqlite3_stmt *events_ = nullptr;
+  bool haveSpan_ = false;
+  bool haveEvent_ = false;
+  TraceRow span_;
+  TraceRow event_;
+  std::vector<std::string> names_;
+  std::vector<std::string> kinds_;
+};
+
+} // namespace schema
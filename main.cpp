@@ -27,8 +27,13 @@ struct SpaceHandle {
   char name[64];
 };
 
-extern "C" void kokkosp_init_library(const int loadSeq,
-                                     const uint64_t interfaceVer,
+struct Kokkos_Tools_ToolSettings {
+  bool requires_global_fencing;
+  bool padding[255];
+};
+
+extern "C" void kokkosp_init_library(const int /*loadSeq*/,
+                                     const uint64_t /*interfaceVer*/,
                                      const uint32_t /*devInfoCount*/,
                                      void * /*deviceInfo*/) {
 
@@ -37,6 +42,16 @@ extern "C" void kokkosp_init_library(const int loadSeq,
 
 extern "C" void kokkosp_finalize_library() { lib::finalize(); }
 
+// Kokkos asks after init_library. Without global fencing, kernels keep running
+// asynchronously and their spans end when the launch returns
+extern "C" void
+kokkosp_request_tool_settings(const uint32_t numActions,
+                              Kokkos_Tools_ToolSettings *settings) {
+  if (numActions > 0) {
+    settings->requires_global_fencing = lib::requires_global_fencing();
+  }
+}
+
 extern "C" void kokkosp_begin_parallel_for(const char *name,
                                            const uint32_t devID,
                                            uint64_t *kID) {
@@ -83,12 +98,15 @@ extern "C" void kokkosp_begin_deep_copy(SpaceHandle dst_handle,
                        src_name, src_ptr, size);
 }
 
+extern "C" void kokkosp_end_deep_copy() { lib::end_deep_copy(); }
+
 extern "C" void kokkosp_begin_fence(const char *name, const uint32_t devID,
                                     uint64_t *kID) {
   // filter out fence as this is a duplicate and unneeded (causing the tool to
   // hinder performance of application). We use strstr for checking if the
   // string contains the label of a fence (we assume the user will always have
-  // the word fence in the label of the fence).
+  // the word fence in the label of the fence). Kokkos only inserts these with
+  // KTS_GLOBAL_FENCES=1, or if it predates kokkosp_request_tool_settings.
   if (std::strstr(name, "Kokkos Profile Tool Fence")) {
     // set the dereferenced execution identifier to be the maximum value of
     // uint64_t, which is assumed to never be assigned
@@ -119,4 +137,21 @@ extern "C" void kokkosp_deallocate_data(SpaceHandle handle, const char *name,
 
 extern "C" void kokkosp_profile_event(char *eventName) {
   lib::profile_event(eventName);
+}
+
+extern "C" void kokkosp_create_profile_section(const char *name,
+                                               uint32_t *secID) {
+  *secID = lib::create_profile_section(name);
+}
+
+extern "C" void kokkosp_start_profile_section(const uint32_t secID) {
+  lib::start_profile_section(secID);
+}
+
+extern "C" void kokkosp_stop_profile_section(const uint32_t secID) {
+  lib::stop_profile_section(secID);
+}
+
+extern "C" void kokkosp_destroy_profile_section(const uint32_t secID) {
+  lib::destroy_profile_section(secID);
 }
\ No newline at end of file
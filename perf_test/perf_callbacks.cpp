@@ -0,0 +1,190 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#include "kts.hpp"
+#include "kts_histogram.hpp"
+#include "kts_overhead.hpp"
+#include "kts_timer.hpp"
+#include "perf_main.hpp"
+
+// libkts on its own, without Kokkos: the latency of each callback, sustained
+// callbacks per second from several threads, and the writer thread, finalize
+// and database that sustain them. Every benchmark profiles a session of its
+// own. Run with --benchmark_format=json for machine-readable results.
+
+namespace {
+
+// one init / finalize pair, writing a fresh database
+class Session {
+public:
+  Session() {
+    delete_database();
+    lib::init();
+  }
+  ~Session() { end(); }
+
+  // Finalize, and report how long it took, the database size per record and
+  // how fast the writer thread inserted. Returns the seconds finalize took
+  double finish(benchmark::State &state, uint64_t records) {
+    const auto start = std::chrono::steady_clock::now();
+    end();
+    const std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    state.counters["finalize_s"] = elapsed.count();
+    state.counters["bytes_per_record"] =
+        records ? double(database_bytes()) / double(records) : 0;
+    for (const lib::OverheadStat &stat : lib::overhead_stats(0)) {
+      if (stat.name == "insert_records_per_second") {
+        state.counters["drain_records_per_second"] = stat.value;
+      }
+    }
+    return elapsed.count();
+  }
+
+private:
+  void end() {
+    if (!finished_) {
+      lib::finalize();
+      finished_ = true;
+    }
+  }
+  bool finished_ = false;
+};
+
+} // namespace
+
+// Time each call of f, which makes callbacks callbacks and produces records
+// records, then finish session. The times include one timer read, see
+// perf_timer
+template <typename F>
+static void latency(benchmark::State &state, Session &session, int callbacks,
+                    int records, F &&f) {
+  schema::Histogram hist;
+  uint64_t maxNs = 0;
+  for (auto _ : state) {
+    const uint64_t start = lib::now_ns();
+    f();
+    const uint64_t ns = lib::now_ns() - start;
+    hist.add(ns);
+    maxNs = std::max(maxNs, ns);
+  }
+  state.counters["callbacks"] = callbacks;
+  state.counters["p50_ns"] = double(hist.quantile(0.5));
+  state.counters["p90_ns"] = double(hist.quantile(0.9));
+  state.counters["p99_ns"] = double(hist.quantile(0.99));
+  state.counters["p999_ns"] = double(hist.quantile(0.999));
+  state.counters["max_ns"] = double(maxNs);
+  session.finish(state, uint64_t(state.iterations()) * records);
+}
+
+// the same, in a session of its own
+template <typename F>
+static void latency(benchmark::State &state, int callbacks, int records,
+                    F &&f) {
+  Session session;
+  latency(state, session, callbacks, records, f);
+}
+
+static void BM_latency_parfor(benchmark::State &state) {
+  latency(state, 2, 1, [] {
+    lib::end_parallel_region(lib::begin_parallel_for("BM_latency_parfor", 0));
+  });
+}
+BENCHMARK(BM_latency_parfor);
+
+static void BM_latency_fence(benchmark::State &state) {
+  latency(state, 2, 1,
+          [] { lib::end_fence(lib::begin_fence("BM_latency_fence", 0)); });
+}
+BENCHMARK(BM_latency_fence);
+
+static void BM_latency_region(benchmark::State &state) {
+  latency(state, 2, 1, [] {
+    lib::push_profile_region("BM_latency_region");
+    lib::pop_profile_region();
+  });
+}
+BENCHMARK(BM_latency_region);
+
+static void BM_latency_deep_copy(benchmark::State &state) {
+  static char dst[64], src[64];
+  latency(state, 2, 1, [] {
+    lib::begin_deep_copy("Host", "dst", dst, "Host", "src", src, sizeof(dst));
+    lib::end_deep_copy();
+  });
+}
+BENCHMARK(BM_latency_deep_copy);
+
+static void BM_latency_alloc(benchmark::State &state) {
+  static char data[64];
+  latency(state, 2, 2, [] {
+    lib::allocate_data("Host", "BM_latency_alloc", data, sizeof(data));
+    lib::deallocate_data("Host", "BM_latency_alloc", data, sizeof(data));
+  });
+}
+BENCHMARK(BM_latency_alloc);
+
+static void BM_latency_event(benchmark::State &state) {
+  latency(state, 1, 1, [] { lib::profile_event("BM_latency_event"); });
+}
+BENCHMARK(BM_latency_event);
+
+static void BM_latency_section(benchmark::State &state) {
+  // the section's name is interned by the session, so it is created inside it
+  Session session;
+  const uint32_t secID = lib::create_profile_section("BM_latency_section");
+  latency(state, session, 2, 0, [secID] {
+    lib::start_profile_section(secID);
+    lib::stop_profile_section(secID);
+  });
+  lib::destroy_profile_section(secID);
+}
+BENCHMARK(BM_latency_section);
+
+// Kernels launched from every thread for long enough that the record queues
+// fill, so the rate is what the writer thread can sustain rather than what
+// the queues can absorb
+static Session *throughputSession = nullptr;
+
+static void BM_throughput(benchmark::State &state) {
+  if (0 == state.thread_index()) {
+    throughputSession = new Session();
+  }
+  const std::string kernel = "kernel_" + std::to_string(state.thread_index());
+  for (auto _ : state) {
+    lib::end_parallel_region(lib::begin_parallel_for(kernel.c_str(), 0));
+  }
+  state.SetItemsProcessed(state.iterations());
+  if (0 == state.thread_index()) {
+    throughputSession->finish(state,
+                              uint64_t(state.iterations()) * state.threads());
+    delete throughputSession;
+    throughputSession = nullptr;
+  }
+}
+BENCHMARK(BM_throughput)
+    ->ThreadRange(1, 16)
+    ->Iterations(1 << 18)
+    ->UseRealTime();
+
+// finalize after state.range(0) kernels: the records still buffered, the
+// remaining inserts and the commit
+static void BM_finalize(benchmark::State &state) {
+  const uint64_t kernels = uint64_t(state.range(0));
+  for (auto _ : state) {
+    Session session;
+    for (uint64_t i = 0; i < kernels; ++i) {
+      lib::end_parallel_region(lib::begin_parallel_for("BM_finalize", 0));
+    }
+    state.SetIterationTime(session.finish(state, kernels));
+  }
+}
+BENCHMARK(BM_finalize)
+    ->Arg(1 << 14)
+    ->Arg(1 << 18)
+    ->UseManualTime()
+    ->Unit(benchmark::kMillisecond);
+
+KTS_SESSION_BENCHMARK_MAIN();
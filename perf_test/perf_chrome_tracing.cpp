@@ -0,0 +1,42 @@
+#include <cstdio>
+#include <filesystem>
+
+#include "kts_chrome_tracing.hpp"
+#include "perf_main.hpp"
+#include "perf_traces.hpp"
+
+static constexpr int NUM_RANKS = 16;
+static constexpr int NUM_SPANS = 20000;
+static const char *TRACE_DIR = "kts_perf_chrome_tracing";
+
+static const std::vector<std::string> &traces() {
+  static const std::vector<std::string> paths =
+      synthetic_traces(TRACE_DIR, NUM_RANKS, NUM_SPANS);
+  return paths;
+}
+
+// convert all synthetic ranks into one trace, with Arg() reader threads
+static void BM_chrome_tracing(benchmark::State &state) {
+  const std::vector<std::string> &inputs = traces();
+  for (auto _ : state) {
+    FILE *f = std::fopen("/dev/null", "wb");
+    schema::write_chrome_trace(f, inputs, state.range(0));
+    std::fclose(f);
+  }
+  // one span per kernel plus the region, and an event per 100 kernels
+  const int64_t rows = NUM_RANKS * (NUM_SPANS + 1 + (NUM_SPANS + 99) / 100);
+  state.SetItemsProcessed(state.iterations() * rows);
+}
+BENCHMARK(BM_chrome_tracing)
+    ->RangeMultiplier(2)
+    ->Range(1, 16)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+int main(int argc, char **argv) {
+  ::benchmark::Initialize(&argc, argv);
+  ::benchmark::RunSpecifiedBenchmarks();
+  ::benchmark::Shutdown();
+  std::filesystem::remove_all(TRACE_DIR);
+  return 0;
+}
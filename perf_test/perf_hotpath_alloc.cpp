@@ -0,0 +1,78 @@
+#include <cstdlib>
+#include <new>
+
+#include "kts.hpp"
+#include "perf_main.hpp"
+
+// heap allocations made by the current thread
+static thread_local size_t numAllocs = 0;
+
+void *operator new(size_t n) {
+  ++numAllocs;
+  if (void *p = std::malloc(n)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, size_t) noexcept { std::free(p); }
+
+// run f once to warm up any caches, then fail the benchmark if f allocates
+template <typename F>
+static void check_allocs(benchmark::State &state, size_t callbacks, F &&f) {
+  f();
+  const size_t before = numAllocs;
+  for (auto _ : state) {
+    f();
+  }
+  const size_t allocs = numAllocs - before;
+  state.counters["allocs_per_callback"] =
+      double(allocs) / double(state.iterations() * callbacks);
+  if (allocs) {
+    kts_bench_fail(state, "callbacks allocated on the heap");
+  }
+}
+
+static void BM_parfor_allocs(benchmark::State &state) {
+  check_allocs(state, 2, [] {
+    lib::end_parallel_region(lib::begin_parallel_for("BM_parfor_allocs", 0));
+  });
+}
+BENCHMARK(BM_parfor_allocs);
+
+static void BM_parred_allocs(benchmark::State &state) {
+  check_allocs(state, 2, [] {
+    lib::end_parallel_region(
+        lib::begin_parallel_reduce("BM_parred_allocs", 0));
+  });
+}
+BENCHMARK(BM_parred_allocs);
+
+static void BM_parscan_allocs(benchmark::State &state) {
+  check_allocs(state, 2, [] {
+    lib::end_parallel_region(lib::begin_parallel_scan("BM_parscan_allocs", 0));
+  });
+}
+BENCHMARK(BM_parscan_allocs);
+
+static void BM_fence_allocs(benchmark::State &state) {
+  check_allocs(state, 2, [] {
+    lib::end_fence(lib::begin_fence("BM_fence_allocs", 0));
+  });
+}
+BENCHMARK(BM_fence_allocs);
+
+static void BM_region_allocs(benchmark::State &state) {
+  check_allocs(state, 2, [] {
+    lib::push_profile_region("BM_region_allocs");
+    lib::pop_profile_region();
+  });
+}
+BENCHMARK(BM_region_allocs);
+
+static void BM_event_allocs(benchmark::State &state) {
+  check_allocs(state, 1, [] { lib::profile_event("BM_event_allocs"); });
+}
+BENCHMARK(BM_event_allocs);
+
+KTS_LIB_BENCHMARK_MAIN();
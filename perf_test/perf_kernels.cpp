@@ -0,0 +1,25 @@
+#include <Kokkos_Core.hpp>
+
+#include "perf_main.hpp"
+
+// Back-to-back launches of a small kernel with one fence at the end, the
+// pattern that global fencing serializes. Run with and without
+// KTS_GLOBAL_FENCES=1 to compare
+static void BM_kernels(benchmark::State &state) {
+  const int launches = 100;
+  Kokkos::View<double *> a("a", state.range(0));
+  for (auto _ : state) {
+    for (int i = 0; i < launches; ++i) {
+      Kokkos::parallel_for(
+          "BM_kernels", a.extent(0),
+          KOKKOS_LAMBDA(const int j) { a(j) += 1; });
+    }
+    Kokkos::fence();
+  }
+  state.counters["kernels"] = benchmark::Counter(
+      double(launches) * state.iterations(), benchmark::Counter::kIsRate);
+}
+// Register the function as a benchmark
+BENCHMARK(BM_kernels)->Arg(1 << 10)->Arg(1 << 16)->UseRealTime();
+
+KTS_BENCHMARK_MAIN();
@@ -5,9 +5,9 @@
 
 #include <benchmark/benchmark.h>
 
-// delete everything in the parent of KTS_SQLITE_PREFIX that has the
-// $KTS_SQLITE_PREFIX(anything).sqlite
-inline static void delete_database() {
+// call f(path) for everything in the parent of KTS_SQLITE_PREFIX that has the
+// $KTS_SQLITE_PREFIX(anything).sqlite, or .ktslog for KTS_OUTPUT=log
+template <typename F> inline static void for_each_database(F &&f) {
   namespace fs = std::filesystem;
 
   const char *rawPrefixPath = std::getenv("KTS_SQLITE_PREFIX");
@@ -22,23 +22,39 @@ inline static void delete_database() {
   }
 
   const std::string prefix = prefixPath.filename().string();
-  const std::string suffix = ".sqlite";
   for (const auto &entry : fs::directory_iterator(prefixDir)) {
     if (entry.is_regular_file()) {
       const auto &path = entry.path();
       const auto &filename = path.filename().string();
 
-      if (filename.size() >= prefix.size() + suffix.size() &&
-          filename.compare(0, prefix.size(), prefix) == 0 &&
-          filename.compare(filename.size() - suffix.size(), suffix.size(),
-                           suffix) == 0) {
-        std::cerr << __FILE__ << ":" << __LINE__ << " remove " << path << "\n";
-        fs::remove(path);
+      for (const std::string suffix : {".sqlite", ".ktslog"}) {
+        if (filename.size() >= prefix.size() + suffix.size() &&
+            filename.compare(0, prefix.size(), prefix) == 0 &&
+            filename.compare(filename.size() - suffix.size(), suffix.size(),
+                             suffix) == 0) {
+          f(path);
+        }
       }
     }
   }
 }
 
+inline static void delete_database() {
+  for_each_database([](const std::filesystem::path &path) {
+    std::cerr << __FILE__ << ":" << __LINE__ << " remove " << path << "\n";
+    std::filesystem::remove(path);
+  });
+}
+
+// the size of the databases on disk
+inline static uintmax_t database_bytes() {
+  uintmax_t bytes = 0;
+  for_each_database([&](const std::filesystem::path &path) {
+    bytes += std::filesystem::file_size(path);
+  });
+  return bytes;
+}
+
 #define KTS_BENCHMARK_MAIN()                                                   \
   int main(int argc, char **argv) {                                            \
     setenv("KTS_SQLITE_PREFIX", "kts_perf_test_", false);                      \
@@ -51,3 +67,40 @@ inline static void delete_database() {
     delete_database();                                                         \
     return 0;                                                                  \
   }
+
+// for benchmarks that drive the lib:: API in kts.hpp directly, without Kokkos.
+// Returns non-zero if a benchmark called kts_bench_fail()
+inline static bool &kts_bench_failed() {
+  static bool failed = false;
+  return failed;
+}
+
+inline static void kts_bench_fail(benchmark::State &state, const char *msg) {
+  kts_bench_failed() = true;
+  state.SkipWithError(msg);
+}
+
+#define KTS_LIB_BENCHMARK_MAIN()                                               \
+  int main(int argc, char **argv) {                                            \
+    setenv("KTS_SQLITE_PREFIX", "kts_perf_test_", false);                      \
+    delete_database();                                                         \
+    lib::init();                                                               \
+    ::benchmark::Initialize(&argc, argv);                                      \
+    ::benchmark::RunSpecifiedBenchmarks();                                     \
+    ::benchmark::Shutdown();                                                   \
+    lib::finalize();                                                           \
+    delete_database();                                                         \
+    return kts_bench_failed() ? 1 : 0;                                         \
+  }
+
+// for benchmarks that init and finalize libkts themselves, one session each
+#define KTS_SESSION_BENCHMARK_MAIN()                                           \
+  int main(int argc, char **argv) {                                            \
+    setenv("KTS_SQLITE_PREFIX", "kts_perf_test_", false);                      \
+    delete_database();                                                         \
+    ::benchmark::Initialize(&argc, argv);                                      \
+    ::benchmark::RunSpecifiedBenchmarks();                                     \
+    ::benchmark::Shutdown();                                                   \
+    delete_database();                                                         \
+    return kts_bench_failed() ? 1 : 0;                                         \
+  }
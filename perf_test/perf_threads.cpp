@@ -0,0 +1,25 @@
+#include <string>
+
+#include "kts.hpp"
+#include "perf_main.hpp"
+
+// Many host threads launching kernels and nesting regions at once. Each thread
+// uses its own labels, as partitioned execution space instances would.
+// Iterations are capped so each thread stays within its record queue and the
+// benchmark measures the callbacks rather than the database.
+static void BM_parfor_threads(benchmark::State &state) {
+  const std::string region = "region_" + std::to_string(state.thread_index());
+  const std::string kernel = "kernel_" + std::to_string(state.thread_index());
+  for (auto _ : state) {
+    lib::push_profile_region(region.c_str());
+    lib::end_parallel_region(lib::begin_parallel_for(kernel.c_str(), 0));
+    lib::pop_profile_region();
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_parfor_threads)
+    ->ThreadRange(1, 16)
+    ->Iterations(16384)
+    ->UseRealTime();
+
+KTS_LIB_BENCHMARK_MAIN();
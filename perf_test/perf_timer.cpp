@@ -0,0 +1,38 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <string>
+
+#include "kts.hpp"
+#include "kts_timer.hpp"
+#include "perf_main.hpp"
+
+// The cost of one timestamp on the KTS_TIMER backend, and the smallest
+// non-zero step seen between consecutive reads. The backend is selected once,
+// at init, as in a profiled run: switching it here would race with the writer
+// thread recalibrating the TSC. Run once per KTS_TIMER value to compare them
+static void BM_timer(benchmark::State &state) {
+  const char *name = lib::timer_name(lib::current_timer());
+  const char *requested = std::getenv("KTS_TIMER");
+  if (requested && *requested && std::string(requested) != name) {
+    state.SkipWithError("timer not available");
+    return;
+  }
+  state.SetLabel(name);
+
+  uint64_t resolution = std::numeric_limits<uint64_t>::max();
+  uint64_t last = lib::now_ns();
+  for (auto _ : state) {
+    const uint64_t t = lib::now_ns();
+    if (t != last) {
+      resolution = std::min(resolution, t - last);
+    }
+    last = t;
+    benchmark::DoNotOptimize(t);
+  }
+  state.counters["resolution_ns"] = double(resolution);
+}
+BENCHMARK(BM_timer);
+
+KTS_LIB_BENCHMARK_MAIN();
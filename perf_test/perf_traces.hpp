@@ -0,0 +1,73 @@
+#pragma once
+
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <sqlite3.h>
+
+#include "kts_schema.hpp"
+#include "kts_trace_reader.hpp"
+
+// Write a trace database as one rank would: numSpans kernels under a
+// region, a few kernel names, and an event every 100 kernels. The indexes
+// KTS_INDEX=1 builds are included, so readers stream without sorting
+inline static void write_synthetic_trace(const std::string &path, int rank,
+                                         int numSpans) {
+  std::filesystem::remove(path);
+  sqlite3 *db = nullptr;
+  if (SQLITE_OK != sqlite3_open(path.c_str(), &db)) {
+    std::cerr << "Can't open database: " << sqlite3_errmsg(db) << std::endl;
+    exit(1);
+  }
+  schema::create_tables(db);
+  schema::init(db);
+  sqlite3_exec(db, "BEGIN TRANSACTION;", 0, 0, 0);
+
+  const std::string version = std::to_string(schema::VERSION);
+  schema::insert(db, schema::Meta{"schema_version", version.c_str()});
+  for (int k = 0; k < int(schema::Kind::NUM_KINDS); ++k) {
+    schema::insert(db, schema::KindName{schema::Kind(k)});
+  }
+  const std::vector<std::string> names = {
+      "outer", "Kokkos::View::initialization [x]", "axpy", "dot",
+      "KokkosSparse::spmv<NoTranspose>", "checkpoint"};
+  for (size_t i = 0; i < names.size(); ++i) {
+    schema::insert(db, schema::Name{int64_t(i), names[i].c_str()});
+  }
+
+  // ranks start a little apart so their streams interleave
+  const int64_t start = rank * 100; // ns
+  const int64_t kernel = 1000;
+  schema::insert(db, schema::SpanRecord{0, rank, 0, 0, schema::Kind::REGION,
+                                        schema::NO_DEVICE, schema::NO_PARENT,
+                                        0, start, start + numSpans * kernel});
+  for (int i = 0; i < numSpans; ++i) {
+    const int64_t t = start + i * kernel;
+    schema::insert(db, schema::SpanRecord{i + 1, rank, 0, 1 + i % 4,
+                                          schema::Kind::PARFOR, 0, 0, 1, t,
+                                          t + kernel / 2});
+    if (i % 100 == 0) {
+      schema::insert(db, schema::EventRecord{rank, 0, 5, schema::Kind::EVENT,
+                                             schema::NO_DEVICE, 0, 1, t});
+    }
+  }
+
+  sqlite3_exec(db, "COMMIT;", 0, 0, 0);
+  schema::create_indexes(db);
+  schema::finalize(db);
+  sqlite3_close(db);
+}
+
+// numRanks synthetic rank databases in dir, written once per process
+inline static std::vector<std::string>
+synthetic_traces(const std::string &dir, int numRanks, int numSpans) {
+  std::filesystem::create_directories(dir);
+  std::vector<std::string> paths;
+  for (int r = 0; r < numRanks; ++r) {
+    paths.push_back(dir + "/kts_" + std::to_string(r) + ".sqlite");
+    write_synthetic_trace(paths.back(), r, numSpans);
+  }
+  return paths;
+}
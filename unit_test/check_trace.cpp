@@ -0,0 +1,203 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <sqlite3.h>
+
+#include "kts_clock_alignment.hpp"
+#include "kts_schema.hpp"
+#include "kts_trace_log.hpp"
+
+// Checks on trace databases, mostly on two runs of the same program, e.g. one
+// with KTS_OUTPUT=log, converted, and one without
+static void help(std::ostream &os) {
+  os << "usage: check_trace same A.sqlite B.sqlite\n"
+     << "       check_trace subset A.sqlite B.sqlite\n"
+     << "       check_trace cut IN.ktslog OUT.ktslog\n"
+     << "       check_trace clocks A.sqlite...\n"
+     << "  same     A and B have the same spans, events and deep copies, and\n"
+     << "           every parent of each is in it, one level up\n"
+     << "  subset   B has some, but not all, of the records of A\n"
+     << "  cut      write IN cut short halfway through its first block to "
+        "OUT\n"
+     << "  clocks   the clock offset at time 0 and drift per ns of each rank,\n"
+     << "           as kts-imbalance aligns them\n";
+}
+
+// The spans, events and deep copies of the database at path, one string per
+// row. Times differ between runs, so they are left out
+static std::vector<std::string> records(const std::string &path) {
+  sqlite3 *db = nullptr;
+  if (SQLITE_OK !=
+      sqlite3_open_v2(path.c_str(), &db, SQLITE_OPEN_READONLY, nullptr)) {
+    std::cerr << "Can't open database: " << sqlite3_errmsg(db) << std::endl;
+    exit(1);
+  }
+  std::vector<std::string> rows;
+  for (const char *sql :
+       {"SELECT 'span', ID, Rank, Tid, Name, Kind, ParentID, Depth "
+        "FROM Spans ORDER BY ID;",
+        "SELECT 'event', ID, Rank, Tid, Name, Kind, ParentID, Depth "
+        "FROM Events ORDER BY ID;",
+        "SELECT 'copy', ID, Rank, Tid, SrcSpace, Src, DstSpace, Dst, Bytes "
+        "FROM DeepCopies ORDER BY ID;"}) {
+    sqlite3_stmt *stmt = schema::prepare_query(db, sql);
+    while (SQLITE_ROW == sqlite3_step(stmt)) {
+      std::string row;
+      for (int i = 0; i < sqlite3_column_count(stmt); ++i) {
+        const char *text =
+            reinterpret_cast<const char *>(sqlite3_column_text(stmt, i));
+        row.append(i ? "|" : "").append(text ? text : "NULL");
+      }
+      rows.push_back(row);
+    }
+    sqlite3_finalize(stmt);
+  }
+  sqlite3_close(db);
+  return rows;
+}
+
+// The spans and events of the database at path whose ParentID is not a span
+// of the same rank, or whose Depth is not one more than their parent's
+static int64_t orphans(const std::string &path) {
+  sqlite3 *db = nullptr;
+  if (SQLITE_OK !=
+      sqlite3_open_v2(path.c_str(), &db, SQLITE_OPEN_READONLY, nullptr)) {
+    std::cerr << "Can't open database: " << sqlite3_errmsg(db) << std::endl;
+    exit(1);
+  }
+  int64_t count = 0;
+  for (const char *table : {"Spans", "Events"}) {
+    const std::string sql =
+        std::string("SELECT COUNT(*) FROM ") + table +
+        " c LEFT JOIN Spans p ON p.ID = c.ParentID AND p.Rank = c.Rank "
+        "WHERE CASE WHEN c.ParentID IS NULL THEN c.Depth != 0 "
+        "ELSE p.ID IS NULL OR c.Depth != p.Depth + 1 END;";
+    sqlite3_stmt *stmt = schema::prepare_query(db, sql.c_str());
+    if (SQLITE_ROW == sqlite3_step(stmt)) {
+      count += sqlite3_column_int64(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+  }
+  sqlite3_close(db);
+  if (count) {
+    std::cerr << path << ": " << count
+              << " records with a missing parent or the wrong depth\n";
+  }
+  return count;
+}
+
+static int same(const std::string &a, const std::string &b) {
+  if (orphans(a) || orphans(b)) {
+    return 1;
+  }
+  const std::vector<std::string> ra = records(a), rb = records(b);
+  for (size_t i = 0; i < ra.size() || i < rb.size(); ++i) {
+    const std::string none = "(none)";
+    const std::string &x = i < ra.size() ? ra[i] : none;
+    const std::string &y = i < rb.size() ? rb[i] : none;
+    if (x != y) {
+      std::cerr << "record " << i << " differs:\n  " << a << ": " << x
+                << "\n  " << b << ": " << y << "\n";
+      return 1;
+    }
+  }
+  std::cerr << ra.size() << " records match\n";
+  return ra.empty() ? 1 : 0;
+}
+
+static int subset(const std::string &a, const std::string &b) {
+  std::vector<std::string> ra = records(a);
+  const std::vector<std::string> rb = records(b);
+  for (const std::string &row : rb) {
+    bool found = false;
+    for (std::string &other : ra) {
+      if (other == row) {
+        other.clear(); // each row of A matches once
+        found = true;
+        break;
+      }
+    }
+    if (!found) {
+      std::cerr << b << ": " << row << " is not in " << a << "\n";
+      return 1;
+    }
+  }
+  std::cerr << rb.size() << " of " << ra.size() << " records\n";
+  return rb.empty() || rb.size() == ra.size() ? 1 : 0;
+}
+
+static int cut(const std::string &in, const std::string &out) {
+  std::ifstream is(in, std::ios::binary);
+  const std::string data((std::istreambuf_iterator<char>(is)),
+                         std::istreambuf_iterator<char>());
+  uint32_t used = 0;
+  if (data.size() >= schema::LOG_HEADER_BYTES + sizeof(used)) {
+    std::memcpy(&used, data.data() + schema::LOG_HEADER_BYTES, sizeof(used));
+  }
+  if (used < 2) {
+    std::cerr << in << " has no records to cut\n";
+    return 1;
+  }
+  // the block header, then half its records
+  const size_t size = schema::LOG_HEADER_BYTES + 8 + used / 2;
+  std::ofstream(out, std::ios::binary).write(data.data(), size);
+  // a database from an earlier conversion would refuse the records again
+  std::remove((out.substr(0, out.rfind('.')) + ".sqlite").c_str());
+  std::cerr << "cut " << in << " to " << size << " bytes\n";
+  return 0;
+}
+
+static int clocks(const std::vector<std::string> &paths) {
+  const std::vector<schema::ClockAlignment> alignments =
+      schema::read_clock_alignments(paths);
+  for (size_t i = 0; i < paths.size(); ++i) {
+    sqlite3 *db = nullptr;
+    if (SQLITE_OK != sqlite3_open_v2(paths[i].c_str(), &db,
+                                     SQLITE_OPEN_READONLY, nullptr)) {
+      std::cerr << "Can't open database: " << sqlite3_errmsg(db) << std::endl;
+      exit(1);
+    }
+    sqlite3_stmt *stmt =
+        schema::prepare_query(db, "SELECT DISTINCT Rank FROM SpanRecords "
+                                  "ORDER BY Rank;");
+    while (SQLITE_ROW == sqlite3_step(stmt)) {
+      const int rank = sqlite3_column_int(stmt, 0);
+      const int64_t second = 1000000000;
+      const int64_t offset = alignments[i].align(rank, 0);
+      const double drift =
+          double(alignments[i].align(rank, second) - offset - second) /
+          double(second);
+      std::cout << paths[i] << " rank " << rank << ": offset " << offset
+                << " drift " << drift << "\n";
+    }
+    sqlite3_finalize(stmt);
+    sqlite3_close(db);
+  }
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  const std::string mode = argc > 1 ? argv[1] : "";
+  if (mode == "clocks" && argc > 2) {
+    return clocks(std::vector<std::string>(argv + 2, argv + argc));
+  }
+  if (argc != 4) {
+    help(std::cerr);
+    return 1;
+  }
+  if (mode == "same") {
+    return same(argv[2], argv[3]);
+  } else if (mode == "subset") {
+    return subset(argv[2], argv[3]);
+  } else if (mode == "cut") {
+    return cut(argv[2], argv[3]);
+  }
+  help(std::cerr);
+  return 1;
+}
@@ -0,0 +1,52 @@
+#include <cstdio>
+#include <fstream>
+
+#include <Kokkos_Core.hpp>
+#include <mpi.h>
+#include <sqlite3.h>
+
+// run under mpiexec with KTS_MPI_SUMMARY=1: each rank launches a different
+// number of kernels, and rank 0 should write the summary at finalize
+int main(int argc, char **argv) {
+  MPI_Init(&argc, &argv);
+  int rank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  std::remove("kts_summary.sqlite");
+  MPI_Barrier(MPI_COMM_WORLD);
+
+  Kokkos::initialize(argc, argv);
+  {
+    for (int i = 0; i < 10 * (rank + 1); ++i) {
+      Kokkos::parallel_for(
+          "test_mpi_summary", 10, KOKKOS_LAMBDA(const int) {});
+    }
+  }
+  Kokkos::finalize();
+
+  int rc = 0;
+  if (0 == rank && !std::ifstream("kts_summary.sqlite")) {
+    std::fprintf(stderr, "kts_summary.sqlite was not written\n");
+    rc = 1;
+  } else if (0 == rank) {
+    // 10 launches on rank 0 and 20 on rank 1
+    sqlite3 *db = nullptr;
+    sqlite3_stmt *stmt = nullptr;
+    sqlite3_open_v2("kts_summary.sqlite", &db, SQLITE_OPEN_READONLY, nullptr);
+    sqlite3_prepare_v2(db,
+                       "SELECT r.Count FROM RankSummaries r "
+                       "JOIN Names n ON n.ID = r.NameID "
+                       "WHERE n.Name = 'test_mpi_summary';",
+                       -1, &stmt, nullptr);
+    const int64_t count =
+        SQLITE_ROW == sqlite3_step(stmt) ? sqlite3_column_int64(stmt, 0) : 0;
+    sqlite3_finalize(stmt);
+    sqlite3_close(db);
+    if (count != 30) {
+      std::fprintf(stderr, "summarized %lld launches, expected 30\n",
+                   (long long)count);
+      rc = 1;
+    }
+  }
+  MPI_Finalize();
+  return rc;
+}
@@ -0,0 +1,23 @@
+#include <Kokkos_Core.hpp>
+
+int main(void) {
+  Kokkos::initialize();
+  {
+    for (int i = 0; i < 10; ++i) {
+      Kokkos::Profiling::ProfilingSection section("section");
+      section.start();
+      Kokkos::parallel_for(
+          "test_section", 10, KOKKOS_LAMBDA(const int) {});
+      {
+        // nested in a section of the same name
+        Kokkos::Profiling::ProfilingSection inner("section");
+        inner.start();
+        Kokkos::parallel_for(
+            "test_section_inner", 10, KOKKOS_LAMBDA(const int) {});
+        inner.stop();
+      }
+      section.stop();
+    }
+  }
+  Kokkos::finalize();
+}
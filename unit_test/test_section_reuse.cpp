@@ -0,0 +1,32 @@
+#include <Kokkos_Core.hpp>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+
+int main(void) {
+  Kokkos::initialize();
+  {
+    // a section destroyed while it is running on another thread, and a new
+    // section made in its place, which that thread then stops
+    auto old = std::make_unique<Kokkos::Profiling::ProfilingSection>("old");
+    std::unique_ptr<Kokkos::Profiling::ProfilingSection> reused;
+    std::atomic<int> step{0};
+    std::thread other([&]() {
+      old->start();
+      step = 1;
+      while (step != 2) {
+        std::this_thread::yield();
+      }
+      reused->stop();
+    });
+    while (step != 1) {
+      std::this_thread::yield();
+    }
+    old.reset();
+    reused = std::make_unique<Kokkos::Profiling::ProfilingSection>("reused");
+    step = 2;
+    other.join();
+  }
+  Kokkos::finalize();
+}
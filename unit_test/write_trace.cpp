@@ -0,0 +1,121 @@
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <sqlite3.h>
+
+#include "kts_schema.hpp"
+
+// Writes small trace databases with known times, for testing the tools on
+// exact numbers
+static void help(std::ostream &os) {
+  os << "usage: write_trace nested OUT.sqlite\n"
+     << "       write_trace ranks PREFIX\n"
+     << "       write_trace sessions OUT.sqlite\n"
+     << "       write_trace wall OUT.sqlite\n"
+     << "  nested   one rank: a 10 ms region \"outer\" holding a 4 ms region\n"
+     << "           \"inner\" with a 1 ms kernel \"axpy\" in it, then a 2 ms\n"
+     << "           \"axpy\" directly in \"outer\"\n"
+     << "  ranks    PREFIX0.sqlite and PREFIX1.sqlite, one kernel \"step\" on\n"
+     << "           each of two ranks, from 1 to 3 ms on rank 0 and from 1 to\n"
+     << "           2 ms on rank 1. Rank 1's mpi clock offset is 1 ms at init\n"
+     << "           and 1.1 ms at finalize, 10 ms later\n"
+     << "  sessions rank 0 of ranks, with the clock offsets of two sessions\n"
+     << "  wall     rank 1 of ranks, with wall clock offsets\n";
+}
+
+// an empty database with the given names, in a transaction
+static sqlite3 *create(const std::string &path,
+                       const std::vector<std::string> &names) {
+  std::remove(path.c_str());
+  sqlite3 *db = nullptr;
+  if (SQLITE_OK != sqlite3_open(path.c_str(), &db)) {
+    std::cerr << "Can't open database: " << sqlite3_errmsg(db) << std::endl;
+    exit(1);
+  }
+  schema::create_tables(db);
+  schema::init(db);
+  sqlite3_exec(db, "BEGIN TRANSACTION;", 0, 0, 0);
+
+  const std::string version = std::to_string(schema::VERSION);
+  schema::insert(db, schema::Meta{"schema_version", version.c_str()});
+  for (int k = 0; k < int(schema::Kind::NUM_KINDS); ++k) {
+    schema::insert(db, schema::KindName{schema::Kind(k)});
+  }
+  for (size_t i = 0; i < names.size(); ++i) {
+    schema::insert(db, schema::Name{int64_t(i), names[i].c_str()});
+  }
+  return db;
+}
+
+static void close(sqlite3 *db) {
+  sqlite3_exec(db, "COMMIT;", 0, 0, 0);
+  schema::finalize(db);
+  sqlite3_close(db);
+}
+
+static int nested(const std::string &path) {
+  sqlite3 *db = create(path, {"outer", "inner", "axpy"});
+  const int64_t ms = 1000000; // ns
+  const schema::Kind region = schema::Kind::REGION;
+  const schema::Kind parfor = schema::Kind::PARFOR;
+  const int64_t none = schema::NO_DEVICE;
+  for (const schema::SpanRecord &span : {
+           schema::SpanRecord{0, 0, 0, 0, region, none, schema::NO_PARENT, 0,
+                              0, 10 * ms},
+           schema::SpanRecord{1, 0, 0, 1, region, none, 0, 1, 1 * ms, 5 * ms},
+           schema::SpanRecord{2, 0, 0, 2, parfor, 0, 1, 2, 2 * ms, 3 * ms},
+           schema::SpanRecord{3, 0, 0, 2, parfor, 0, 0, 1, 6 * ms, 8 * ms},
+       }) {
+    schema::insert(db, span);
+  }
+  close(db);
+  return 0;
+}
+
+// rank's kernel "step" from start to stop ms, and its clock offsets from
+// source: offset ms at init, at 0 ms, and drifted by drift ms at finalize, at
+// 10 ms. With sessions > 1, each session's offsets are written
+static void rank_trace(const std::string &path, int rank, int64_t start,
+                       int64_t stop, const char *source, double offset,
+                       double drift, int sessions) {
+  sqlite3 *db = create(path, {"step"});
+  const int64_t ms = 1000000; // ns
+  schema::insert(db, schema::SpanRecord{0, rank, 0, 0, schema::Kind::PARFOR, 0,
+                                        schema::NO_PARENT, 0, start * ms,
+                                        stop * ms});
+  for (int i = 0; i < sessions; ++i) {
+    schema::insert(db, schema::ClockOffset{rank, "init", source, 0,
+                                           int64_t(offset * ms), 0});
+    schema::insert(db,
+                   schema::ClockOffset{rank, "finalize", source, 10 * ms,
+                                       int64_t((offset + drift) * ms), 0});
+  }
+  close(db);
+}
+
+int main(int argc, char **argv) {
+  if (argc != 3) {
+    help(std::cerr);
+    return 1;
+  }
+  const std::string mode = argv[1];
+  const std::string out = argv[2];
+  if (mode == "nested") {
+    return nested(out);
+  } else if (mode == "ranks") {
+    rank_trace(out + "0.sqlite", 0, 1, 3, "mpi", 0, 0, 1);
+    rank_trace(out + "1.sqlite", 1, 1, 2, "mpi", 1, 0.1, 1);
+    return 0;
+  } else if (mode == "sessions") {
+    rank_trace(out, 0, 1, 3, "mpi", 0, 0, 2);
+    return 0;
+  } else if (mode == "wall") {
+    rank_trace(out, 1, 1, 2, "wall", 1, 0.1, 1);
+    return 0;
+  }
+  help(std::cerr);
+  return 1;
+}